@@ -19,13 +19,15 @@ find_library(Tiff_LIBRARY NAMES tiff
   /usr/lib
   /usr/local/lib)
 
-if(BUILD_STATIC)
-# -llept -lgif -lwebp -ltiff -lpng -ljpeg -lz
-find_library(Lept_LIBRARY NAMES lept
+# Leptonica (Pix images are passed to tesseract directly)
+find_library(Lept_LIBRARY NAMES lept leptonica
   HINTS
   /usr/lib
   /usr/local/lib)
 
+if(BUILD_STATIC)
+# -llept -lgif -lwebp -ltiff -lpng -ljpeg -lz
+
 find_library(Webp_LIBRARY NAMES webp
   HINTS
   /usr/lib
@@ -59,7 +61,7 @@ list(REMOVE_ITEM CMAKE_REQUIRED_INCLUDES ${Tesseract_INCLUDE_DIR})
 if(BUILD_STATIC)
   set(Tesseract_LIBRARIES ${Tesseract_LIBRARIES} ${Lept_LIBRARY} ${PNG_LIBRARY} ${Tiff_LIBRARY} ${Webp_LIBRARY} ${GIF_LIBRARY} ${JPEG_LIBRARY} ${ZLIB_LIBRARY})
 else()
-  set(Tesseract_LIBRARIES ${Tesseract_LIBRARIES} ${Tiff_LIBRARY})
+  set(Tesseract_LIBRARIES ${Tesseract_LIBRARIES} ${Lept_LIBRARY} ${Tiff_LIBRARY})
 endif()
 
 include(FindPackageHandleStandardArgs)
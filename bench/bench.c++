@@ -0,0 +1,356 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Micro-benchmarks of the demux, assembly and decode hot paths on synthetic
+// subtitles. Every benchmark reports the median time per input byte or
+// output pixel, which stays comparable when the amount of data changes.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bench_hooks.h"
+#include "synth.h++"
+
+// VobSub2SRT
+#include "cmd_options.h++"
+#include "image_prep.h++"
+
+// MPlayer
+#include "spudec.h"
+
+using namespace std;
+
+namespace {
+typedef chrono::steady_clock bench_clock;
+
+double elapsed_ns(bench_clock::time_point start) {
+  return chrono::duration<double, nano>(bench_clock::now() - start).count();
+}
+
+// Synthetic subtitles of one stream: the .sub, its .idx, the SPU packets
+// themselves and a large multi-stream .idx for the parser.
+struct input_t {
+  vector<unsigned char> sub;
+  string idx, large_idx;
+  vector<vector<unsigned char> > spus;
+  vector<unsigned> pts;
+  vector<spu_image_t> images;
+};
+
+input_t make_input(unsigned cues, unsigned width, unsigned height) {
+  enum { frame_width = 720, frame_height = 576, duration = 2 * 90000 };
+  input_t in;
+  vector<vector<idx_entry_t> > streams(1);
+  for (unsigned i = 0; i < cues; ++i) {
+    in.images.push_back(pattern_image(width, height, i));
+    in.spus.push_back(encode_spu(in.images.back(), (frame_width - width) / 2,
+                                 frame_height - height - 40, duration));
+    unsigned const ms = 1000 + i * 3000;
+    in.pts.push_back(ms * 90);
+    idx_entry_t const entry = {ms,
+                               append_spu_packs(in.sub, 0, ms * 90,
+                                                in.spus.back())};
+    streams[0].push_back(entry);
+  }
+  in.idx = make_idx(frame_width, frame_height, streams);
+  // the parser doesn't care about the .sub, so the positions can be made up
+  vector<vector<idx_entry_t> > many(8);
+  for (unsigned sid = 0; sid < many.size(); ++sid) {
+    for (unsigned i = 0; i < 5000; ++i) {
+      idx_entry_t const entry = {1000 + i * 3000, uint64_t(i) * 4096};
+      many[sid].push_back(entry);
+    }
+  }
+  in.large_idx = make_idx(frame_width, frame_height, many);
+  return in;
+}
+
+// A deleted temporary file. mplayer/vobsub.c only reads file descriptors, so
+// every run gets its own descriptor positioned at the start.
+struct temp_file {
+  temp_file(void const *data, size_t size) : file(tmpfile()) {
+    if (file == NULL or fwrite(data, 1, size, file) != size or
+        fflush(file) != 0) {
+      cerr << "Can't write a temporary file\n";
+      exit(1);
+    }
+  }
+  ~temp_file() { fclose(file); }
+  int open() const {
+    int const fd = dup(fileno(file));
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+  }
+  FILE *file;
+
+ private:
+  // noncopyable
+  temp_file(temp_file const &);
+  temp_file &operator=(temp_file const &);
+};
+
+struct result_t {
+  string name;
+  char const *unit;
+  double ns;  ///< median per unit
+};
+
+// Runs sample (returning ns per unit) repeat times and keeps the median,
+// which shrugs off the odd preempted sample.
+template <typename F>
+double median_of(int repeat, F sample) {
+  vector<double> samples;
+  for (int i = 0; i < repeat; ++i) samples.push_back(sample());
+  sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+void *new_decoder(input_t const &in) {
+  vector<unsigned char> header(in.idx.begin(), in.idx.end());
+  return spudec_new_scaled(NULL, 0, 0, header.data(), header.size(), 0);
+}
+
+// Feeds a SPU packet in fragments of the size a pack carries
+void assemble(void *spu, vector<unsigned char> const &packet, unsigned pts) {
+  enum { fragment = 2024 };
+  unsigned char *data = const_cast<unsigned char *>(packet.data());
+  for (size_t pos = 0; pos < packet.size(); pos += fragment) {
+    size_t const len = min<size_t>(fragment, packet.size() - pos);
+    spudec_assemble(spu, data + pos, len, pts);
+  }
+}
+
+vector<result_t> run_benchmarks(input_t const &in, int iterations,
+                                int repeat) {
+  vector<result_t> results;
+  temp_file const sub(in.sub.data(), in.sub.size());
+  temp_file const large_idx(in.large_idx.data(), in.large_idx.size());
+
+  result_t demux = {"mpeg_run", "byte", 0};
+  demux.ns = median_of(repeat, [&] {
+    auto const start = bench_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      if (bench_mpeg_scan(sub.open()) < long(in.spus.size())) {
+        cerr << "mpeg_run lost packets\n";
+        exit(1);
+      }
+    }
+    return elapsed_ns(start) / (double(in.sub.size()) * iterations);
+  });
+  results.push_back(demux);
+
+  result_t parse = {"vobsub_parse_one_line", "byte", 0};
+  parse.ns = median_of(repeat, [&] {
+    auto const start = bench_clock::now();
+    for (int i = 0; i < iterations; ++i) bench_parse_idx(large_idx.open());
+    return elapsed_ns(start) / (double(in.large_idx.size()) * iterations);
+  });
+  results.push_back(parse);
+
+  size_t spu_bytes = 0;
+  for (size_t i = 0; i < in.spus.size(); ++i) spu_bytes += in.spus[i].size();
+  void *spu = new_decoder(in);
+  result_t assembly = {"spudec_assemble+heartbeat", "byte", 0};
+  assembly.ns = median_of(repeat, [&] {
+    auto const start = bench_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      spudec_reset(spu);
+      for (size_t j = 0; j < in.spus.size(); ++j) {
+        assemble(spu, in.spus[j], in.pts[j]);
+        spudec_heartbeat(spu, in.pts[j]);
+      }
+    }
+    return elapsed_ns(start) / (double(spu_bytes) * iterations);
+  });
+  results.push_back(assembly);
+
+  // the decoders below work on the queued, not yet decoded packets
+  spudec_reset(spu);
+  vector<void *> packets;
+  for (size_t j = 0; j < in.spus.size(); ++j) {
+    assemble(spu, in.spus[j], in.pts[j]);
+    void *const packet = bench_spudec_take_packet(spu);
+    if (packet) packets.push_back(packet);
+  }
+  if (packets.size() != in.spus.size()) {
+    cerr << "spudec_assemble lost packets\n";
+    exit(1);
+  }
+
+  result_t rle = {"spudec_process_data", "pixel", 0};
+  rle.ns = median_of(repeat, [&] {
+    double pixels = 0;
+    auto const start = bench_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < packets.size(); ++j)
+        pixels += bench_spudec_process_data(spu, packets[j]);
+    }
+    return elapsed_ns(start) / pixels;
+  });
+  results.push_back(rle);
+
+  // spudec_cut_image needs a fresh image every time, so it is timed
+  // together with pal2gray_alpha and the difference is reported
+  result_t gray = {"pal2gray_alpha", "pixel", 0};
+  result_t cut = {"spudec_cut_image", "pixel", 0};
+  vector<double> cut_samples;
+  gray.ns = median_of(repeat, [&] {
+    double pixels = 0, gray_ns = 0, both_ns = 0;
+    for (size_t j = 0; j < packets.size(); ++j) {
+      bench_spudec_process_data(spu, packets[j]);
+      auto start = bench_clock::now();
+      for (int i = 0; i < iterations; ++i) pixels += bench_pal2gray_alpha(spu);
+      gray_ns += elapsed_ns(start);
+      start = bench_clock::now();
+      for (int i = 0; i < iterations; ++i) {
+        bench_pal2gray_alpha(spu);
+        bench_spudec_cut_image(spu);
+      }
+      both_ns += elapsed_ns(start);
+    }
+    cut_samples.push_back(max(0.0, both_ns - gray_ns) / pixels);
+    return gray_ns / pixels;
+  });
+  sort(cut_samples.begin(), cut_samples.end());
+  cut.ns = cut_samples[cut_samples.size() / 2];
+  results.push_back(gray);
+  results.push_back(cut);
+
+  for (size_t j = 0; j < packets.size(); ++j)
+    bench_spudec_free_packet(packets[j]);
+  spudec_free(spu);
+
+  // the gray images the OCR preparation starts from
+  vector<vector<unsigned char> > grays;
+  for (size_t j = 0; j < in.images.size(); ++j) {
+    static unsigned char const levels[4] = {0x00, 0xff, 0x20, 0x80};
+    vector<unsigned char> image(in.images[j].pixels.size());
+    for (size_t k = 0; k < image.size(); ++k)
+      image[k] = levels[in.images[j].pixels[k]];
+    grays.push_back(image);
+  }
+  vector<unsigned char> inverted;
+  result_t invert = {"invert_image", "pixel", 0};
+  invert.ns = median_of(repeat, [&] {
+    double pixels = 0;
+    auto const start = bench_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < grays.size(); ++j) {
+        inverted.resize(grays[j].size());
+        invert_image(grays[j].data(), grays[j].size(), inverted.data());
+        pixels += grays[j].size();
+      }
+    }
+    return elapsed_ns(start) / pixels;
+  });
+  results.push_back(invert);
+  return results;
+}
+
+// Baselines are "name ns" lines
+bool load_baseline(string const &filename, map<string, double> &baseline) {
+  ifstream in(filename.c_str());
+  if (!in) {
+    cerr << "Can't read baseline " << filename << '\n';
+    return false;
+  }
+  string name;
+  double ns;
+  while (in >> name >> ns) baseline[name] = ns;
+  return true;
+}
+
+bool save_baseline(string const &filename, vector<result_t> const &results) {
+  ofstream out(filename.c_str());
+  for (size_t i = 0; i < results.size(); ++i)
+    out << results[i].name << ' ' << results[i].ns << '\n';
+  if (!out) cerr << "Can't write baseline " << filename << '\n';
+  return bool(out);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  int cues = 200, width = 600, height = 80, iterations = 10, repeat = 5;
+  int tolerance = 10;
+  string save, compare;
+  {
+    cmd_options opts;
+    opts.add_option("cues", cues, "number of synthetic subtitles")
+        .add_option("width", width, "width of the subtitle images")
+        .add_option("height", height, "height of the subtitle images")
+        .add_option("iterations", iterations,
+                    "passes over the subtitles per sample")
+        .add_option("repeat", repeat,
+                    "samples per benchmark, the median is reported")
+        .add_option("save", save, "write the results as a baseline file")
+        .add_option("compare", compare,
+                    "compare the results with this baseline file")
+        .add_option("tolerance", tolerance,
+                    "percent a benchmark may be slower than the baseline "
+                    "before bench fails");
+    if (!opts.parse_cmd(argc, argv)) return 1;
+  }
+  if (cues < 1 or width < 16 or height < 16 or width > 720 or height > 576 or
+      iterations < 1 or repeat < 1) {
+    cerr << "Invalid --cues, --width, --height, --iterations or --repeat\n";
+    return 1;
+  }
+  map<string, double> baseline;
+  if (!compare.empty() and !load_baseline(compare, baseline)) return 1;
+
+  input_t const in = make_input(cues, width, height);
+  vector<result_t> const results = run_benchmarks(in, iterations, repeat);
+
+  bool regression = false;
+  cout << left << setw(28) << "benchmark" << right << setw(10) << "ns/unit"
+       << "  unit";
+  if (!baseline.empty()) cout << setw(12) << "baseline" << setw(10) << "change";
+  cout << '\n' << fixed;
+  for (size_t i = 0; i < results.size(); ++i) {
+    result_t const &r = results[i];
+    cout << left << setw(28) << r.name << right << setprecision(3) << setw(10)
+         << r.ns << "  " << r.unit;
+    auto const base = baseline.find(r.name);
+    if (base != baseline.end() and base->second > 0) {
+      double const change = (r.ns / base->second - 1.0) * 100.0;
+      cout << setw(17 - string(r.unit).size()) << base->second
+           << setprecision(1) << setw(9) << showpos << change << noshowpos
+           << '%';
+      if (change > tolerance) {
+        cout << "  REGRESSION";
+        regression = true;
+      }
+    }
+    cout << '\n';
+  }
+  if (!save.empty() and !save_baseline(save, results)) return 1;
+  return regression ? 1 : 0;
+}
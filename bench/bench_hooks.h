@@ -0,0 +1,56 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Entry points into the static functions of mplayer/vobsub.c and
+ * mplayer/spudec.c. They only exist when those files are compiled with
+ * VOBSUB2SRT_BENCH, which bench/CMakeLists.txt does for the bench program. */
+
+#ifndef BENCH_HOOKS_H
+#define BENCH_HOOKS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runs mpeg_run over the MPEG-PS data of fd until its end and closes fd.
+ * Returns the number of subtitle packets or -1 on errors. */
+long bench_mpeg_scan(int fd);
+/* Runs vobsub_parse_one_line over the .idx data of fd and closes fd. Returns
+ * the number of parsed lines. */
+long bench_parse_idx(int fd);
+
+/* The next packet spudec_assemble has queued, NULL if there is none. Free it
+ * with bench_spudec_free_packet. */
+void *bench_spudec_take_packet(void *spu);
+void bench_spudec_free_packet(void *packet);
+/* Decodes the RLE data of packet (spudec_process_data, which also applies
+ * the palette and cuts the image). Returns the number of pixels. */
+unsigned bench_spudec_process_data(void *spu, const void *packet);
+/* Converts the decoded palette image to gray and alpha again and resets the
+ * size spudec_cut_image changes. Returns the number of pixels. */
+unsigned bench_pal2gray_alpha(void *spu);
+void bench_spudec_cut_image(void *spu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_HOOKS_H */
@@ -0,0 +1,105 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "process.h++"
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// The rusage of the child has its CPU time and peak RSS.
+bool run_program(vector<string> const &args, run_usage_t &usage) {
+  vector<char *> argv;
+  for (size_t i = 0; i < args.size(); ++i)
+    argv.push_back(const_cast<char *>(args[i].c_str()));
+  argv.push_back(NULL);
+  auto const start = chrono::steady_clock::now();
+  pid_t const pid = fork();
+  if (pid < 0) {
+    cerr << "fork failed: " << strerror(errno) << '\n';
+    return false;
+  }
+  if (pid == 0) {
+    int const null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+  int status;
+  struct rusage child;
+  while (wait4(pid, &status, 0, &child) < 0) {
+    if (errno != EINTR) {
+      cerr << "wait4 failed: " << strerror(errno) << '\n';
+      return false;
+    }
+  }
+  usage.wall = chrono::duration<double>(chrono::steady_clock::now() - start)
+                   .count();
+  if (!WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+    cerr << "Failed (status " << status << "):";
+    for (size_t i = 0; i < args.size(); ++i) cerr << ' ' << args[i];
+    cerr << '\n';
+    return false;
+  }
+  usage.cpu = child.ru_utime.tv_sec + child.ru_utime.tv_usec / 1e6 +
+              child.ru_stime.tv_sec + child.ru_stime.tv_usec / 1e6;
+  usage.peak_rss = child.ru_maxrss / 1024.0;  // KiB on Linux
+  return true;
+}
+
+string program_next_to(char const *argv0, char const *name) {
+  string const self = argv0;
+  size_t const slash = self.rfind('/');
+  return (slash == string::npos ? string(".") : self.substr(0, slash)) + '/' +
+         name;
+}
+
+bool file_exists(string const &name) {
+  struct stat st;
+  return stat(name.c_str(), &st) == 0;
+}
+
+bool make_work_dir(string &dir) {
+  if (dir.empty()) {
+    char const *tmp = getenv("TMPDIR");
+    dir = string(tmp ? tmp : "/tmp") + "/vobsub2srt-bench-XXXXXX";
+    if (mkdtemp(&dir[0]) == NULL) {
+      cerr << "Can't create a temporary directory: " << strerror(errno)
+           << '\n';
+      return false;
+    }
+  } else if (mkdir(dir.c_str(), 0755) < 0 and errno != EEXIST) {
+    cerr << "Can't create " << dir << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,46 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PROCESS_HXX
+#define PROCESS_HXX
+
+#include <string>
+#include <vector>
+
+/// What running a program cost
+struct run_usage_t {
+  double wall, cpu;  ///< seconds
+  double peak_rss;   ///< MiB
+};
+
+/// Runs args[0] (a path) with the arguments and its output discarded and
+/// waits for it. Fails (with a message) unless it exits with status 0.
+bool run_program(std::vector<std::string> const &args, run_usage_t &usage);
+
+/// The path of the program name in the directory of argv0
+std::string program_next_to(char const *argv0, char const *name);
+
+bool file_exists(std::string const &name);
+
+/// Creates dir, or a temporary directory if it is empty (and sets dir)
+bool make_work_dir(std::string &dir);
+
+#endif
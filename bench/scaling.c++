@@ -0,0 +1,254 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Runs the whole vobsub2srt pipeline over a sweep of worker counts and input
+// sizes and reports how the throughput scales.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "process.h++"
+#include "synth.h++"
+
+// VobSub2SRT
+#include "cmd_options.h++"
+
+using namespace std;
+
+namespace {
+/// One point of the sweep
+struct point_t {
+  unsigned cues, threads;
+  double wall, cpu;   ///< seconds
+  double efficiency;  ///< speedup over the fewest threads, per thread
+  double peak_rss;    ///< MiB
+};
+
+bool parse_list(string const &text, char const *option,
+                vector<unsigned> &list) {
+  list.clear();
+  istringstream in(text);
+  string item;
+  while (getline(in, item, ',')) {
+    char *end;
+    unsigned long const value = strtoul(item.c_str(), &end, 10);
+    if (item.empty() or *end != '\0' or value == 0) {
+      cerr << "Invalid --" << option << " '" << text << "'\n";
+      return false;
+    }
+    list.push_back(value);
+  }
+  sort(list.begin(), list.end());
+  list.erase(unique(list.begin(), list.end()), list.end());
+  return !list.empty();
+}
+
+vector<string> split_args(string const &text) {
+  vector<string> args;
+  istringstream in(text);
+  string arg;
+  while (in >> arg) args.push_back(arg);
+  return args;
+}
+
+// The cues of the first stream of an .idx
+unsigned count_cues(string const &subname) {
+  ifstream idx((subname + ".idx").c_str());
+  unsigned cues = 0, streams = 0;
+  string line;
+  while (getline(idx, line)) {
+    if (line.compare(0, 3, "id:") == 0 and ++streams > 1) break;
+    if (line.compare(0, 10, "timestamp:") == 0) ++cues;
+  }
+  return cues;
+}
+
+void write_csv(ostream &out, vector<point_t> const &points) {
+  out << "cues,threads,wall_s,cpu_s,cues_per_s,efficiency,peak_rss_mib\n";
+  for (size_t i = 0; i < points.size(); ++i) {
+    point_t const &p = points[i];
+    out << p.cues << ',' << p.threads << ',' << p.wall << ',' << p.cpu << ','
+        << p.cues / p.wall << ',' << p.efficiency << ',' << p.peak_rss
+        << '\n';
+  }
+}
+
+void write_json(ostream &out, vector<point_t> const &points) {
+  out << "[\n";
+  for (size_t i = 0; i < points.size(); ++i) {
+    point_t const &p = points[i];
+    out << "  {\"cues\":" << p.cues << ",\"threads\":" << p.threads
+        << ",\"wall_s\":" << p.wall << ",\"cpu_s\":" << p.cpu
+        << ",\"cues_per_s\":" << p.cues / p.wall
+        << ",\"efficiency\":" << p.efficiency
+        << ",\"peak_rss_mib\":" << p.peak_rss << '}'
+        << (i + 1 < points.size() ? ",\n" : "\n");
+  }
+  out << "]\n";
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  string vobsub2srt, input, threads_text, cues_text = "100,1000,10000";
+  string work_dir, extra_args, report = "-", format = "csv";
+  int repeat = 1;
+  bool fake_ocr = false;
+  {
+    ostringstream threads_default;
+    unsigned const cores = max(1u, thread::hardware_concurrency());
+    for (unsigned n = 1; n <= cores; n *= 2)
+      threads_default << (n > 1 ? "," : "") << n;
+    threads_text = threads_default.str();
+
+    cmd_options opts;
+    opts.add_option("vobsub2srt", vobsub2srt,
+                    "the program to run (default: vobsub2srt next to this "
+                    "program)")
+        .add_option("input", input,
+                    "convert these subtitles (name WITHOUT .idx/.sub) "
+                    "instead of synthetic ones")
+        .add_option("threads", threads_text,
+                    "comma separated --max-threads values (default: powers "
+                    "of two up to the number of cores)")
+        .add_option("cues", cues_text,
+                    "comma separated sizes of the synthetic subtitles")
+        .add_option("fake-ocr", fake_ocr,
+                    "use the fake OCR engine to measure everything but the "
+                    "OCR")
+        .add_option("args", extra_args,
+                    "further arguments for vobsub2srt, separated by spaces")
+        .add_option("repeat", repeat,
+                    "runs per point, the one with the median time is kept")
+        .add_option("work-dir", work_dir,
+                    "keep the synthetic subtitles and the output in this "
+                    "directory and reuse them (default: a temporary "
+                    "directory)")
+        .add_option("report", report, "write the report to this file")
+        .add_option("format", format, "format of the report: csv or json");
+    if (!opts.parse_cmd(argc, argv)) return 1;
+  }
+  vector<unsigned> thread_counts, sizes;
+  if (!parse_list(threads_text, "threads", thread_counts) or
+      (input.empty() and !parse_list(cues_text, "cues", sizes)))
+    return 1;
+  if (repeat < 1 or (format != "csv" and format != "json")) {
+    cerr << "Invalid --repeat or --format\n";
+    return 1;
+  }
+  if (vobsub2srt.empty()) vobsub2srt = program_next_to(argv[0], "vobsub2srt");
+  bool const temporary = work_dir.empty();
+  if (!make_work_dir(work_dir)) return 1;
+  string const output = work_dir + "/out.srt";
+  vector<string> created(1, output);
+
+  vector<point_t> points;
+  bool ok = true;
+  if (!input.empty()) sizes.assign(1, count_cues(input));
+  for (size_t s = 0; ok and s < sizes.size(); ++s) {
+    string subname = input;
+    if (input.empty()) {
+      ostringstream name;
+      name << work_dir << "/synthetic-" << sizes[s];
+      subname = name.str();
+      created.push_back(subname + ".idx");
+      created.push_back(subname + ".sub");
+      corpus_options_t options;
+      options.cues = sizes[s];
+      if (!(file_exists(subname + ".idx") and file_exists(subname + ".sub")) and
+          !write_corpus(subname, options)) {
+        ok = false;
+        break;
+      }
+    }
+    size_t const first = points.size();
+    for (size_t t = 0; ok and t < thread_counts.size(); ++t) {
+      ostringstream threads;
+      threads << thread_counts[t];
+      vector<string> args;
+      args.push_back(vobsub2srt);
+      args.push_back("--max-threads");
+      args.push_back(threads.str());
+      args.push_back("--output");
+      args.push_back(output);
+      if (fake_ocr) {
+        args.push_back("--ocr-engine");
+        args.push_back("fake");
+      }
+      vector<string> const extra = split_args(extra_args);
+      args.insert(args.end(), extra.begin(), extra.end());
+      args.push_back(subname);
+      vector<point_t> runs;
+      for (int r = 0; ok and r < repeat; ++r) {
+        point_t point = {sizes[s], thread_counts[t], 0, 0, 0, 0};
+        run_usage_t usage;
+        ok = run_program(args, usage);
+        point.wall = usage.wall;
+        point.cpu = usage.cpu;
+        point.peak_rss = usage.peak_rss;
+        runs.push_back(point);
+      }
+      if (!ok) break;
+      sort(runs.begin(), runs.end(), [](point_t const &a, point_t const &b) {
+        return a.wall < b.wall;
+      });
+      point_t point = runs[runs.size() / 2];
+      point_t const &base = points.size() > first ? points[first] : point;
+      point.efficiency =
+          base.wall * base.threads / (point.wall * point.threads);
+      points.push_back(point);
+      cerr << setw(7) << point.cues << " cues " << setw(3) << point.threads
+           << " threads: " << fixed << setprecision(3) << point.wall
+           << " s, " << setprecision(1) << point.cues / point.wall
+           << " cues/s, efficiency " << setprecision(2) << point.efficiency
+           << ", peak RSS " << setprecision(1) << point.peak_rss << " MiB\n";
+    }
+  }
+
+  if (temporary) {
+    for (size_t i = 0; i < created.size(); ++i) unlink(created[i].c_str());
+    rmdir(work_dir.c_str());
+  }
+  if (!ok) return 1;
+  ofstream file;
+  if (report != "-") {
+    file.open(report.c_str());
+    if (!file) {
+      cerr << "Can't write " << report << '\n';
+      return 1;
+    }
+  }
+  ostream &out = report != "-" ? file : cout;
+  if (format == "json")
+    write_json(out, points);
+  else
+    write_csv(out, points);
+  return out ? 0 : 1;
+}
@@ -0,0 +1,511 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "synth.h++"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+// deterministic, so benchmarks and goldens see the same images everywhere
+struct random_t {
+  explicit random_t(unsigned seed) : state(seed * 2654435761u + 1) {}
+  unsigned next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+  unsigned below(unsigned n) { return next() % n; }
+  unsigned state;
+};
+
+// Writes the RLE codes of a field nibble by nibble
+struct nibble_writer {
+  explicit nibble_writer(vector<unsigned char> &out) : out(out), half(false) {}
+  void put(unsigned nibble) {
+    if (half)
+      out.back() |= nibble;
+    else
+      out.push_back(nibble << 4);
+    half = !half;
+  }
+  // every line starts at a byte
+  void align() { half = false; }
+  // 1 to 4 nibbles, depending on the length (at most 255)
+  void run(unsigned length, unsigned color) {
+    unsigned const code = length << 2 | color;
+    if (length >= 64) {
+      put(0);
+      put(code >> 8);
+      put(code >> 4 & 0xf);
+    } else if (length >= 16) {
+      put(0);
+      put(code >> 4);
+    } else if (length >= 4) {
+      put(code >> 4);
+    }
+    put(code & 0xf);
+  }
+
+  vector<unsigned char> &out;
+  bool half;
+};
+
+void encode_field(spu_image_t const &image, unsigned first_row,
+                  vector<unsigned char> &out) {
+  nibble_writer writer(out);
+  for (unsigned y = first_row; y < image.height; y += 2) {
+    unsigned char const *row = &image.pixels[y * image.width];
+    for (unsigned x = 0; x < image.width;) {
+      unsigned length = 1;
+      while (x + length < image.width and row[x + length] == row[x] and
+             length < 255)
+        ++length;
+      writer.run(length, row[x]);
+      x += length;
+    }
+    writer.align();
+  }
+}
+
+void put16(vector<unsigned char> &out, unsigned value) {
+  out.push_back(value >> 8 & 0xff);
+  out.push_back(value & 0xff);
+}
+
+void set16(vector<unsigned char> &out, size_t pos, unsigned value) {
+  out[pos] = value >> 8 & 0xff;
+  out[pos + 1] = value & 0xff;
+}
+
+// 5x7 glyphs, one byte per row with the leftmost pixel in bit 4
+char const font_chars[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?'-:";
+unsigned char const font_rows[][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // space
+    {0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11},  // A
+    {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e},
+    {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e},
+    {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c},
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f},
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10},
+    {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f},
+    {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11},
+    {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e},
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c},
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f},
+    {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11},
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+    {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e},
+    {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10},
+    {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d},
+    {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11},
+    {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e},
+    {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e},
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04},
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a},
+    {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11},
+    {0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04},
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f},  // Z
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e},  // 0
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e},
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f},
+    {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e},
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02},
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e},
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e},
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e},
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c},  // 9
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c},  // .
+    {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08},  // ,
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04},  // !
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04},  // ?
+    {0x0c, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00},  // '
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00},  // -
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}};  // :
+// a glyph is 5x7 pixels in a cell of 6x9
+enum { glyph_width = 5, glyph_height = 7, cell_width = 6, cell_height = 9 };
+
+unsigned char const *glyph(char c) {
+  if (c >= 'a' and c <= 'z') c += 'A' - 'a';
+  char const *found = c != '\0' ? strchr(font_chars, c) : NULL;
+  if (found == NULL) found = strchr(font_chars, '?');
+  return font_rows[found - font_chars];
+}
+
+void draw_glyph(spu_image_t &image, char c, unsigned left, unsigned top,
+                unsigned scale) {
+  unsigned char const *rows = glyph(c);
+  for (unsigned gy = 0; gy < glyph_height * scale; ++gy) {
+    unsigned char *row = &image.pixels[(top + gy) * image.width + left];
+    for (unsigned gx = 0; gx < glyph_width * scale; ++gx) {
+      if (rows[gy / scale] >> (glyph_width - 1 - gx / scale) & 1)
+        row[gx] = spu_image_t::PATTERN;
+    }
+  }
+}
+
+// Greedy word wrap to lines of at most columns characters. Words longer
+// than a line are cut.
+vector<string> wrap_text(string const &text, size_t columns) {
+  vector<string> lines(1);
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t const start = text.find_first_not_of(' ', pos);
+    if (start == string::npos) break;
+    size_t end = text.find(' ', start);
+    if (end == string::npos) end = text.size();
+    string const word = text.substr(start, min(end - start, columns));
+    if (!lines.back().empty() and
+        lines.back().size() + 1 + word.size() > columns)
+      lines.push_back(string());
+    if (!lines.back().empty()) lines.back() += ' ';
+    lines.back() += word;
+    pos = end;
+  }
+  return lines;
+}
+}  // namespace
+
+void add_outline(spu_image_t &image) {
+  unsigned const w = image.width, h = image.height;
+  vector<unsigned char> &p = image.pixels;
+  for (unsigned y = 0; y < h; ++y) {
+    for (unsigned x = 0; x < w; ++x) {
+      if (p[y * w + x] != spu_image_t::PATTERN) continue;
+      for (unsigned ny = y ? y - 1 : 0; ny <= y + 1 and ny < h; ++ny) {
+        for (unsigned nx = x ? x - 1 : 0; nx <= x + 1 and nx < w; ++nx) {
+          if (p[ny * w + nx] == spu_image_t::BACKGROUND)
+            p[ny * w + nx] = spu_image_t::EMPHASIS1;
+        }
+      }
+    }
+  }
+}
+
+spu_image_t pattern_image(unsigned width, unsigned height, unsigned seed) {
+  spu_image_t image;
+  image.width = width;
+  image.height = height;
+  image.pixels.assign(size_t(width) * height, spu_image_t::BACKGROUND);
+  random_t random(seed);
+  unsigned const lines = height >= 60 ? 2 : 1;
+  unsigned const line_height = (height - 4) / lines;
+  unsigned const scale = max(1u, line_height * 3 / 4 / 7);
+  for (unsigned line = 0; line < lines; ++line) {
+    unsigned const top = 2 + line * line_height;
+    unsigned x = 2, word = 3 + random.below(5);
+    while (x + 6 * scale + 2 <= width) {
+      if (word-- == 0) {  // a space between words
+        word = 3 + random.below(5);
+        x += 4 * scale;
+        continue;
+      }
+      unsigned const bits = random.next();  // 5x7 glyph, 32 bits are enough
+      for (unsigned gy = 0; gy < 7; ++gy) {
+        for (unsigned gx = 0; gx < 5; ++gx) {
+          if (!(bits >> (gy * 5 + gx) % 32 & 1)) continue;
+          for (unsigned sy = 0; sy < scale; ++sy) {
+            unsigned const y = top + gy * scale + sy;
+            if (y + 2 >= height) continue;
+            for (unsigned sx = 0; sx < scale; ++sx)
+              image.pixels[y * width + x + gx * scale + sx] =
+                  spu_image_t::PATTERN;
+          }
+        }
+      }
+      x += 6 * scale;
+    }
+  }
+  add_outline(image);
+  return image;
+}
+
+spu_image_t text_image(string const &text, unsigned width, unsigned height,
+                       unsigned scale) {
+  spu_image_t image;
+  image.width = width;
+  image.height = height;
+  image.pixels.assign(size_t(width) * height, spu_image_t::BACKGROUND);
+  // a margin of two pixels keeps the outline inside
+  if (scale == 0) scale = max(1u, (height - 4) / (2 * cell_height));
+  size_t const columns = (width - 4) / (cell_width * scale);
+  size_t const max_lines = (height - 4) / (cell_height * scale);
+  if (columns == 0 or max_lines == 0) return image;
+  vector<string> lines = wrap_text(text, columns);
+  if (lines.size() > max_lines) lines.resize(max_lines);
+  for (size_t l = 0; l < lines.size(); ++l) {
+    unsigned const line_width = lines[l].size() * cell_width * scale;
+    unsigned const left = (width - line_width) / 2;
+    unsigned const top = 2 + l * cell_height * scale;
+    for (size_t i = 0; i < lines[l].size(); ++i)
+      draw_glyph(image, lines[l][i], left + i * cell_width * scale, top,
+                 scale);
+  }
+  add_outline(image);
+  return image;
+}
+
+string sample_text(unsigned seed) {
+  static char const *const words[] = {
+      "I", "YOU", "WE", "THEY", "THE", "A", "THIS", "THAT", "IS", "WAS", "WILL",
+      "CAN'T", "DON'T", "KNOW", "SEE", "COME", "GO", "HOME", "NOW", "HERE",
+      "THERE", "WHY", "WHERE", "OKAY", "RIGHT", "TIME", "WAY", "DOOR", "SHIP",
+      "ROAD", "MONEY", "LATE", "QUICK", "OVER", "AT", "7:30", "42", "WELL",
+      "JUST", "ABOUT", "NIGHT", "TODAY", "SORRY", "NEVER", "AGAIN", "THINK",
+      "REALLY", "DOCTOR", "CAPTAIN"};
+  static char const endings[] = ".?!";
+  unsigned const count = sizeof(words) / sizeof(words[0]);
+  random_t random(seed);
+  unsigned const length = 2 + random.below(9);
+  string text;
+  for (unsigned i = 0; i < length; ++i) {
+    if (i > 0) text += random.below(8) == 0 ? ", " : " ";
+    text += words[random.below(count)];
+  }
+  text += endings[random.below(3)];
+  return text;
+}
+
+vector<unsigned char> encode_spu(spu_image_t const &image, unsigned x,
+                                 unsigned y, unsigned duration, size_t size) {
+  vector<unsigned char> spu(4);  // size and control offset follow
+  encode_field(image, 0, spu);
+  size_t const bottom = spu.size();
+  encode_field(image, 1, spu);
+  size_t const control_size = duration > 0 ? 24 + 6 : 24;
+  if (spu.size() + control_size < size) spu.resize(size - control_size, 0xff);
+  size_t const control = spu.size();
+  // without a duration there is only the show sequence, pointing to itself
+  size_t const stop = duration > 0 ? control + 24 : control;
+  // show: date, next, palette, alpha, coordinates, field offsets, start
+  put16(spu, 0);
+  put16(spu, stop);
+  unsigned char const show[] = {
+      0x03, 0x32, 0x10,  // colors: emphasis 2, emphasis 1, pattern, back
+      0x04, 0xff, 0xf0,  // alpha of the same, the background is clear
+      0x05};
+  spu.insert(spu.end(), show, show + sizeof(show));
+  unsigned const x2 = x + image.width - 1, y2 = y + image.height - 1;
+  spu.push_back(x >> 4);
+  spu.push_back((x & 0xf) << 4 | x2 >> 8);
+  spu.push_back(x2 & 0xff);
+  spu.push_back(y >> 4);
+  spu.push_back((y & 0xf) << 4 | y2 >> 8);
+  spu.push_back(y2 & 0xff);
+  spu.push_back(0x06);
+  put16(spu, 4);
+  put16(spu, bottom);
+  spu.push_back(0x01);
+  spu.push_back(0xff);
+  if (duration > 0) {
+    // hide: the date is in units of 1024 / 90000 s, the last sequence
+    // points to itself
+    put16(spu, duration / 1024);
+    put16(spu, stop);
+    spu.push_back(0x02);
+    spu.push_back(0xff);
+  }
+  set16(spu, 0, spu.size());
+  set16(spu, 2, control);
+  return spu;
+}
+
+uint64_t append_spu_packs(vector<unsigned char> &sub, unsigned sid,
+                          unsigned pts, vector<unsigned char> const &spu,
+                          size_t max_chunk) {
+  enum { pack_size = 2048, pack_header_size = 14, padding_header_size = 6 };
+  // MPEG-2 pack header, mpeg_run skips the SCR and mux rate
+  static unsigned char const pack_header[pack_header_size] = {
+      0x00, 0x00, 0x01, 0xba, 0x44, 0x00, 0x04,
+      0x00, 0x04, 0x01, 0x01, 0x89, 0xc3, 0xf8};
+  uint64_t const first = sub.size();
+  size_t pos = 0;
+  for (bool first_pes = true; pos < spu.size(); first_pes = false) {
+    sub.insert(sub.end(), pack_header, pack_header + pack_header_size);
+    unsigned const pts_size = first_pes ? 5 : 0;
+    // start code and length, flags and header length, PTS, substream id
+    size_t const room = pack_size - pack_header_size - 6 - 3 - pts_size - 1;
+    size_t const left = spu.size() - pos;
+    size_t chunk = min(left, room);
+    if (max_chunk > 0) chunk = min(chunk, max_chunk);
+    // The last pack of a packet ends with padding. A pack without padding
+    // makes mpeg_run merge the next pack into the same packet.
+    if (chunk == left and room - chunk < padding_header_size)
+      chunk = room - padding_header_size;
+    // spudec_assemble drops fragments shorter than 2 bytes, don't leave one
+    // for the next pack
+    if (left - chunk == 1) {
+      if (chunk > 2)
+        --chunk;
+      else
+        ++chunk;
+    }
+    size_t const leftover = room - chunk;
+    // gaps too small for a padding packet are stuffed into the PES header
+    size_t const stuffing = leftover < padding_header_size ? leftover : 0;
+    size_t const header_length = pts_size + stuffing;
+    size_t const pes_length = 3 + header_length + 1 + chunk;
+    unsigned char const pes[] = {0x00, 0x00, 0x01, 0xbd,
+                                 (unsigned char)(pes_length >> 8),
+                                 (unsigned char)(pes_length & 0xff),
+                                 0x81, (unsigned char)(first_pes ? 0x80 : 0),
+                                 (unsigned char)header_length};
+    sub.insert(sub.end(), pes, pes + sizeof(pes));
+    if (first_pes) {
+      sub.push_back(0x21 | (pts >> 29 & 0x0e));
+      sub.push_back(pts >> 22 & 0xff);
+      sub.push_back((pts >> 14 & 0xfe) | 1);
+      sub.push_back(pts >> 7 & 0xff);
+      sub.push_back((pts << 1 & 0xfe) | 1);
+    }
+    sub.insert(sub.end(), stuffing, 0xff);
+    sub.push_back(0x20 + sid);
+    sub.insert(sub.end(), spu.begin() + pos, spu.begin() + pos + chunk);
+    pos += chunk;
+    if (leftover >= padding_header_size) {
+      size_t const padding = leftover - padding_header_size;
+      unsigned char const padding_header[padding_header_size] = {
+          0x00, 0x00, 0x01, 0xbe, (unsigned char)(padding >> 8),
+          (unsigned char)(padding & 0xff)};
+      sub.insert(sub.end(), padding_header,
+                 padding_header + padding_header_size);
+      sub.insert(sub.end(), padding, 0xff);
+    }
+  }
+  return first;
+}
+
+string make_idx(unsigned frame_width, unsigned frame_height,
+                vector<vector<idx_entry_t> > const &streams) {
+  static char const *const languages[] = {"en", "de", "fr", "es", "it", "nl",
+                                          "sv", "da", "fi", "no", "pt", "pl",
+                                          "cs", "hu", "el", "tr", "ru", "ja",
+                                          "zh", "ko", "he", "ar", "hi", "th",
+                                          "id", "ro", "bg", "hr", "sk", "sl",
+                                          "uk", "is"};
+  char line[128];
+  string idx = "# VobSub index file, v7 (do not modify this line!)\n";
+  snprintf(line, sizeof(line), "size: %ux%u\n", frame_width, frame_height);
+  idx += line;
+  // background, text, outline and a gray for emphasis 2
+  idx += "palette: 000000, ffffff, 000000, 808080";
+  for (int i = 4; i < 16; ++i) idx += ", 000000";
+  idx += "\nlangidx: 0\n";
+  for (size_t sid = 0; sid < streams.size() and sid < 32; ++sid) {
+    snprintf(line, sizeof(line), "\nid: %s, index: %u\n", languages[sid],
+             unsigned(sid));
+    idx += line;
+    for (size_t i = 0; i < streams[sid].size(); ++i) {
+      unsigned const ms = streams[sid][i].ms;
+      snprintf(line, sizeof(line),
+               "timestamp: %02u:%02u:%02u:%03u, filepos: %09llx\n",
+               ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000,
+               (unsigned long long)streams[sid][i].filepos);
+      idx += line;
+    }
+  }
+  return idx;
+}
+
+bool write_corpus(string const &subname, corpus_options_t const &options) {
+  enum { frame_width = 720, frame_height = 576, first_ms = 1000 };
+  if (options.width < 16 or options.height < 16 or
+      options.width > frame_width or options.height > frame_height) {
+    cerr << "Synthetic subtitles must be between 16x16 and " << frame_width
+         << 'x' << frame_height << " pixels\n";
+    return false;
+  }
+  if (options.packet_size > 0 and
+      options.packet_size + options.cues > 0xffff) {
+    cerr << "SPU packets can't be padded beyond 65535 bytes\n";
+    return false;
+  }
+  if (options.max_chunk == 1) {
+    cerr << "SPU packets can't be split into single bytes\n";
+    return false;
+  }
+  if (options.streams < 1 or options.streams > 32) {
+    cerr << "There can be 1 to 32 subtitle streams\n";
+    return false;
+  }
+  uint64_t const last_ms = first_ms +
+                           uint64_t(options.cues) * options.interval +
+                           options.duration;
+  if (last_ms * 90 > 0xffffffffULL) {
+    cerr << "The timestamps of " << options.cues
+         << " cues overflow, use a shorter interval\n";
+    return false;
+  }
+  string const sub_name = subname + ".sub", idx_name = subname + ".idx";
+  ofstream sub(sub_name.c_str(), ios::binary);
+  unsigned const x = (frame_width - options.width) / 2;
+  unsigned const y = options.height + 40 < frame_height
+                         ? frame_height - options.height - 40
+                         : 0;
+  random_t random(options.seed);
+  unsigned const duplicate_limit =
+      static_cast<unsigned>(min(1.0, max(0.0, options.duplicates)) * 1000000);
+  vector<vector<idx_entry_t> > streams(options.streams);
+  vector<vector<unsigned> > seeds(options.streams);  // of every cue's image
+  vector<unsigned char> packs;
+  uint64_t pos = 0;
+  for (unsigned i = 0; i < options.cues and sub; ++i) {
+    unsigned const ms = first_ms + i * options.interval;
+    for (unsigned sid = 0; sid < options.streams; ++sid) {
+      unsigned seed = options.seed + sid * options.cues + i;
+      if (i > 0 and random.below(1000000) < duplicate_limit)
+        seed = seeds[sid][random.below(i)];
+      seeds[sid].push_back(seed);
+      spu_image_t const image =
+          options.text ? text_image(sample_text(seed), options.width,
+                                    options.height, options.font_scale)
+                       : pattern_image(options.width, options.height, seed);
+      packs.clear();
+      append_spu_packs(
+          packs, sid, ms * 90,
+          encode_spu(image, x, y, options.duration * 90,
+                     options.packet_size > 0 ? options.packet_size + i : 0),
+          options.max_chunk);
+      idx_entry_t const entry = {ms, pos};
+      streams[sid].push_back(entry);
+      sub.write(reinterpret_cast<char const *>(packs.data()), packs.size());
+      pos += packs.size();
+    }
+  }
+  ofstream idx(idx_name.c_str());
+  idx << make_idx(frame_width, frame_height, streams);
+  sub.close();
+  idx.close();
+  if (!sub or !idx) {
+    cerr << "Can't write " << (sub ? idx_name : sub_name) << '\n';
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,112 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SYNTH_HXX
+#define SYNTH_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// A subtitle image in the four SPU colors, one byte per pixel
+struct spu_image_t {
+  enum {
+    BACKGROUND = 0,  ///< transparent
+    PATTERN = 1,     ///< the text
+    EMPHASIS1 = 2,   ///< its outline
+    EMPHASIS2 = 3
+  };
+  unsigned width, height;
+  std::vector<unsigned char> pixels;
+};
+
+/// An image of lines of random blocky glyphs with an outline, close enough to
+/// text for the decoder (similar run lengths and line structure)
+spu_image_t pattern_image(unsigned width, unsigned height, unsigned seed);
+
+/// Renders text (upper case letters, digits and . , ! ? ' - :) with a built-in
+/// 5x7 font enlarged scale times (0: two lines fill the height) and adds an
+/// outline. Lines are broken at spaces, what doesn't fit is left out.
+spu_image_t text_image(std::string const &text, unsigned width,
+                       unsigned height, unsigned scale = 0);
+
+/// A sentence of a few words, the same for the same seed
+std::string sample_text(unsigned seed);
+
+/// Paints EMPHASIS1 around every PATTERN pixel
+void add_outline(spu_image_t &image);
+
+/// Encodes a SPU packet the way DVDs do: two RLE coded fields (even and odd
+/// lines) and two control sequences, one to show the image at x, y of the
+/// frame and one to hide it after duration (90 kHz). A duration of 0 leaves
+/// the hide sequence out, the image is then shown until the next one. Packets
+/// smaller than size are padded between the fields and the control sequences.
+std::vector<unsigned char> encode_spu(spu_image_t const &image, unsigned x,
+                                      unsigned y, unsigned duration,
+                                      size_t size = 0);
+
+/// Appends the SPU packet to a .sub file as MPEG-2 program stream packs of
+/// 2048 bytes (private stream 1, substream 0x20 + sid). Packets larger than
+/// max_chunk bytes (or a pack) are split across packs, max_chunk must be 0 or
+/// at least 2. Returns the position of the first pack for the .idx.
+uint64_t append_spu_packs(std::vector<unsigned char> &sub, unsigned sid,
+                          unsigned pts, std::vector<unsigned char> const &spu,
+                          size_t max_chunk = 0);
+
+/// An .idx entry
+struct idx_entry_t {
+  unsigned ms;  ///< start time in milliseconds
+  uint64_t filepos;
+};
+
+/// The .idx file for the packs, one list of entries per stream (the index is
+/// the sid)
+std::string make_idx(unsigned frame_width, unsigned frame_height,
+                     std::vector<std::vector<idx_entry_t> > const &streams);
+
+/// Settings of a synthetic .idx/.sub pair
+struct corpus_options_t {
+  corpus_options_t()
+      : cues(1000), streams(1), width(600), height(80), interval(400),
+        duration(300), max_chunk(0), packet_size(0), duplicates(0),
+        font_scale(0), text(true), seed(0) {}
+  unsigned cues;           ///< per stream
+  unsigned streams;        ///< at most 32, showing their cues at once
+  unsigned width, height;  ///< of the images, the frame is 720x576
+  unsigned interval;       ///< milliseconds from one cue to the next
+  unsigned duration;       ///< milliseconds a cue is shown, 0: no end
+  size_t max_chunk;        ///< SPU bytes per pack, 0: as many as fit
+  /// pad the SPU packet of cue i to packet_size + i bytes (see encode_spu),
+  /// to hit the pack boundaries, 0: no padding
+  size_t packet_size;
+  double duplicates;       ///< share of cues repeating an earlier image
+  unsigned font_scale;     ///< see text_image
+  bool text;               ///< text_image, or pattern_image if false
+  unsigned seed;
+};
+
+/// Writes <subname>.idx and <subname>.sub. The packs are written cue by cue,
+/// so the size of the corpus is only limited by the 32 bit timestamps of
+/// vobsub.c (about 13 hours).
+bool write_corpus(std::string const &subname, corpus_options_t const &options);
+
+#endif
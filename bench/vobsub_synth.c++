@@ -0,0 +1,97 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Writes synthetic .idx/.sub subtitles of any size for testing and
+// benchmarking, see write_corpus.
+
+#include <iostream>
+#include <string>
+
+#include "synth.h++"
+
+// VobSub2SRT
+#include "cmd_options.h++"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+  corpus_options_t const defaults;
+  int cues = defaults.cues, streams = defaults.streams;
+  int width = defaults.width, height = defaults.height;
+  int interval = defaults.interval, duration = defaults.duration;
+  int max_chunk = 0, packet_size = 0, duplicates = 0, font_scale = 0, seed = 0;
+  bool pattern = false;
+  string subname;
+  {
+    cmd_options opts;
+    opts.add_option("cues", cues, "subtitles per stream")
+        .add_option("streams", streams, "number of subtitle streams (1-32)")
+        .add_option("width", width, "width of the subtitle images")
+        .add_option("height", height, "height of the subtitle images")
+        .add_option("interval", interval,
+                    "milliseconds from one subtitle to the next")
+        .add_option("duration", duration,
+                    "milliseconds a subtitle is shown (0: until the next "
+                    "one)")
+        .add_option("max-chunk", max_chunk,
+                    "split the subtitle packets into pieces of at most this "
+                    "many bytes (default: fill the 2048 byte packs)")
+        .add_option("packet-size", packet_size,
+                    "pad the subtitle packets to this many bytes plus one "
+                    "per subtitle, to hit every split at the pack boundary "
+                    "(default: no padding)")
+        .add_option("duplicates", duplicates,
+                    "percentage of subtitles repeating an earlier image")
+        .add_option("font-scale", font_scale,
+                    "enlarge the 5x7 pixel font this many times (default: "
+                    "two lines fill the height)")
+        .add_option("pattern", pattern,
+                    "random blocks of glyphs instead of words")
+        .add_option("seed", seed, "varies the text")
+        .add_unnamed(subname, "subname",
+                     "name of the subtitle files WITHOUT .idx/.sub ending "
+                     "(REQUIRED)");
+    if (!opts.parse_cmd(argc, argv) or subname.empty()) return 1;
+  }
+  if (cues < 0 or streams < 0 or width < 0 or height < 0 or interval < 0 or
+      duration < 0 or max_chunk < 0 or packet_size < 0 or duplicates < 0 or
+      duplicates > 100 or font_scale < 0 or seed < 0) {
+    cerr << "The options can't be negative, --duplicates is 0-100\n";
+    return 1;
+  }
+  corpus_options_t options;
+  options.cues = cues;
+  options.streams = streams;
+  options.width = width;
+  options.height = height;
+  options.interval = interval;
+  options.duration = duration;
+  options.max_chunk = max_chunk;
+  options.packet_size = packet_size;
+  options.duplicates = duplicates / 100.0;
+  options.font_scale = font_scale;
+  options.text = !pattern;
+  options.seed = seed;
+  if (!write_corpus(subname, options)) return 1;
+  cout << "Wrote " << cues << " subtitles in " << streams << " stream"
+       << (streams == 1 ? "" : "s") << " to " << subname << ".idx/.sub\n";
+  return 0;
+}
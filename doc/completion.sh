@@ -29,24 +29,56 @@ _vobsub2srt() {
             _filedir '(ifo|IFO)'
             return 0
             ;;
+        --unrar|--sub-stream)
+            _filedir
+            return 0
+            ;;
         --lang|-l)
             _get_first_arg
-            tmp=$( "$cmd" --langlist -- "$arg" 2>/dev/null | sed -E -e '/Languages:/d; s/^[[:digit:]]+: //;' )
+            tmp=$( "$cmd" --langlist -- "$arg" 2>/dev/null | sed -E -e '/Languages/d; s/^[[:digit:]]+: //;' )
             COMPREPLY=( $( compgen -W "$tmp" -- "$cur" ) )
             return 0
             ;;
-        --tesseract-data)
+        --title-set)
+            COMPREPLY=( $( compgen -W '1 2 3 4 5 6 7 8 9' -- "$cur" ) )
+            return 0
+            ;;
+        --tesseract-data|--cascade-data)
             _filedir -d
             return 0
             ;;
+        --ocr-cache|--output|-o|--write-corpus|--ocr-from-corpus|--stats-json|--telemetry|--trace)
+            _filedir
+            return 0
+            ;;
+        --dump-format)
+            COMPREPLY=( $( compgen -W 'pgm png tiff tar' -- "$cur" ) )
+            return 0
+            ;;
+        --format)
+            COMPREPLY=( $( compgen -W 'srt vtt ass ndjson' -- "$cur" ) )
+            return 0
+            ;;
+        --tesseract-psm)
+            COMPREPLY=( $( compgen -W '6 7 13' -- "$cur" ) )
+            return 0
+            ;;
+        --ocr-engine)
+            COMPREPLY=( $( compgen -W 'tesseract fake' -- "$cur" ) )
+            return 0
+            ;;
+        --timeout-policy)
+            COMPREPLY=( $( compgen -W 'empty downscale legacy' -- "$cur" ) )
+            return 0
+            ;;
     esac
 
     case $cur in
         -*)
-            COMPREPLY=( $( compgen -W '--dump-images --verbose --ifo --lang --langlist --tesseract-lang --tesseract-data --blacklist --y-threshold --min-width --min-height --dpi --max-threads' -- "$cur" ) )
+            COMPREPLY=( $( compgen -W '--dump-images --dump-format --write-corpus --ocr-from-corpus --verbose --output --format --ifo --sub-stream --index-cache --unrar --lang --langlist --title-set --tesseract-lang --tesseract-data --tesseract-psm --ocr-engine --ocr-latency --blacklist --y-threshold --min-width --min-height --dpi --scale-height --max-threads --lookahead --ocr-timeout --timeout-policy --cascade-confidence --cascade-data --cascade-oem --ocr-cache --ocr-cache-size --resume --stats --stats-json --telemetry --trace --progress-fd' -- "$cur" ) )
             ;;
         *)
-            _filedir '(idx|IDX|sub|SUB)'
+            _filedir '(idx|IDX|sub|SUB|mkv|MKV|mks|MKS|webm|WEBM|iso|ISO)'
             COMPREPLY=$( echo "$COMPREPLY" | sed -E -e 's/.(idx|IDX|sub|SUB)$//' ) # remove suffix
             ;;
     esac
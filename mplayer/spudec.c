@@ -63,6 +63,7 @@ typedef struct spu_packet_t packet_t;
 struct spu_packet_t {
   int is_decoded;
   unsigned char *packet;
+  unsigned int packet_reserve; /* size of the memory pointed to by packet */
   int data_len;
   unsigned int palette[4];
   unsigned int alpha[4];
@@ -126,6 +127,9 @@ typedef struct {
       is_forced_sub; /* true if current subtitle is a forced subtitle */
 
   struct palette_crop_cache palette_crop_cache;
+
+  packet_t *free_packets;    /* done packets kept with their buffers */
+  unsigned long allocations; /* of packets and images, see spudec_get_memory */
 } spudec_handle_t;
 
 static void spudec_queue_packet(spudec_handle_t *this, packet_t *packet) {
@@ -150,6 +154,39 @@ static void spudec_free_packet(packet_t *packet) {
   free(packet);
 }
 
+/* Keeps a packet that is done for spudec_get_packet, so that decoding
+ * needs no allocations once the buffers are large enough. */
+static void spudec_recycle_packet(spudec_handle_t *this, packet_t *packet) {
+  packet->next = this->free_packets;
+  this->free_packets = packet;
+}
+
+/* A cleared packet with room for size bytes of data */
+static packet_t *spudec_get_packet(spudec_handle_t *this, unsigned int size) {
+  packet_t *packet = this->free_packets;
+  unsigned char *data = NULL;
+  unsigned int reserve = 0;
+  if (packet) {
+    this->free_packets = packet->next;
+    data = packet->packet;
+    reserve = packet->packet_reserve;
+    memset(packet, 0, sizeof(*packet));
+  } else {
+    packet = calloc(1, sizeof(packet_t));
+    if (packet == NULL) return NULL;
+    ++this->allocations;
+  }
+  if (reserve < size) {
+    free(data);
+    data = malloc(size);
+    reserve = data ? size : 0;
+    ++this->allocations;
+  }
+  packet->packet = data;
+  packet->packet_reserve = reserve;
+  return packet;
+}
+
 static inline unsigned int get_be16(const unsigned char *p) {
   return (p[0] << 8) + p[1];
 }
@@ -233,6 +270,7 @@ static int spudec_alloc_image(spudec_handle_t *this, int stride, int height) {
       this->pal_width = this->pal_height = 0;
     }
     this->image = malloc(2 * this->stride * this->height);
+    this->allocations += 2;
     if (this->image) {
       this->image_size = this->stride * this->height;
       this->aimage = this->image + this->image_size;
@@ -552,8 +590,13 @@ static void spudec_process_control(spudec_handle_t *this, int pts100) {
       end_pts = 1 - pts100 >= end_pts ? 0 : pts100 + end_pts - 1;
     }
     if (end_pts > 0) {
-      packet_t *packet = calloc(1, sizeof(packet_t));
+      packet_t *packet = spudec_get_packet(this, this->packet_size);
       int i;
+      if (packet == NULL || packet->packet == NULL) {
+        mp_msg(MSGT_SPUDEC, MSGL_FATAL, "spudec: malloc failure\n");
+        if (packet) spudec_recycle_packet(this, packet);
+        continue;
+      }
       packet->start_pts = start_pts;
       packet->end_pts = end_pts;
       packet->current_nibble[0] = current_nibble[0];
@@ -568,7 +611,6 @@ static void spudec_process_control(spudec_handle_t *this, int pts100) {
         packet->alpha[i] = this->alpha[i];
         packet->palette[i] = this->palette[i];
       }
-      packet->packet = malloc(this->packet_size);
       memcpy(packet->packet, this->packet, this->packet_size);
       spudec_queue_packet(this, packet);
     }
@@ -600,6 +642,7 @@ void spudec_assemble(void *this, unsigned char *packet, unsigned int len,
       free(spu->packet);
       spu->packet = malloc(len2);
       spu->packet_reserve = spu->packet != NULL ? len2 : 0;
+      ++spu->allocations;
     }
     if (spu->packet != NULL) {
       spu->packet_size = len2;
@@ -664,7 +707,8 @@ void spudec_assemble(void *this, unsigned char *packet, unsigned int len,
 void spudec_reset(void *this)  // called after seek
 {
   spudec_handle_t *spu = this;
-  while (spu->queue_head) spudec_free_packet(spudec_dequeue_packet(spu));
+  while (spu->queue_head)
+    spudec_recycle_packet(spu, spudec_dequeue_packet(spu));
   spu->now_pts = 0;
   spu->end_pts = 0;
   spu->packet_size = spu->packet_offset = 0;
@@ -685,6 +729,7 @@ void spudec_heartbeat(void *this, unsigned int pts100) {
       spu->image = packet->packet;
       spu->aimage = packet->packet + packet->stride * packet->height;
       packet->packet = NULL;
+      packet->packet_reserve = 0;
       spu->width = packet->width;
       spu->height = packet->height;
       spu->stride = packet->stride;
@@ -698,7 +743,7 @@ void spudec_heartbeat(void *this, unsigned int pts100) {
       if (spu->auto_palette) compute_palette(spu, packet);
       spudec_process_data(spu, packet);
     }
-    spudec_free_packet(packet);
+    spudec_recycle_packet(spu, packet);
     spu->spu_changed = 1;
   }
 }
@@ -896,6 +941,7 @@ void spudec_draw_scaled(void *me, unsigned int dxs, unsigned int dys,
           }
           spu->scaled_image =
               malloc(2 * spu->scaled_stride * spu->scaled_height);
+          ++spu->allocations;
           if (spu->scaled_image) {
             spu->scaled_image_size = spu->scaled_stride * spu->scaled_height;
             spu->scaled_aimage = spu->scaled_image + spu->scaled_image_size;
@@ -1343,6 +1389,11 @@ void spudec_free(void *this) {
   spudec_handle_t *spu = this;
   if (spu) {
     while (spu->queue_head) spudec_free_packet(spudec_dequeue_packet(spu));
+    while (spu->free_packets) {
+      packet_t *packet = spu->free_packets;
+      spu->free_packets = packet->next;
+      spudec_free_packet(packet);
+    }
     free(spu->packet);
     spu->packet = NULL;
     free(spu->scaled_image);
@@ -1375,6 +1426,7 @@ packet_t *spudec_packet_create(int x, int y, int w, int h) {
   packet->data_len = 2 * stride * h;
   if (packet->data_len) {  // size 0 is a special "clear" packet
     packet->packet = malloc(packet->data_len);
+    packet->packet_reserve = packet->data_len;
     if (!packet->packet) {
       free(packet);
       packet = NULL;
@@ -1448,3 +1500,64 @@ void spudec_get_data(void *this, const unsigned char **image,
   *start_pts = spu->start_pts;
   *end_pts = spu->end_pts;
 }
+
+void spudec_get_memory(void *this, size_t *bytes,
+                       unsigned long *allocations) {
+  spudec_handle_t *spu = this;
+  const packet_t *packet;
+  /* image and aimage, pal_image of the same size */
+  size_t sum = spu->packet_reserve + 3 * spu->image_size +
+               2 * spu->scaled_image_size;
+  for (packet = spu->queue_head; packet; packet = packet->next)
+    sum += sizeof(*packet) + packet->packet_reserve;
+  for (packet = spu->free_packets; packet; packet = packet->next)
+    sum += sizeof(*packet) + packet->packet_reserve;
+  *bytes = sum;
+  *allocations = spu->allocations;
+}
+
+/* Position of the image returned by spudec_get_data in the video frame. The
+ * frame size is 0 if it is unknown. */
+void spudec_get_position(void *this, unsigned *x, unsigned *y,
+                         unsigned *frame_width, unsigned *frame_height) {
+  spudec_handle_t *spu = this;
+  *x = spu->start_col;
+  *y = spu->start_row;
+  *frame_width = spu->orig_frame_width;
+  *frame_height = spu->orig_frame_height;
+}
+
+#ifdef VOBSUB2SRT_BENCH
+/* Entry points for the micro-benchmarks in bench/ */
+#include "bench_hooks.h"
+
+void *bench_spudec_take_packet(void *this) {
+  spudec_handle_t *spu = this;
+  return spu->queue_head ? spudec_dequeue_packet(spu) : NULL;
+}
+
+void bench_spudec_free_packet(void *packet) { spudec_free_packet(packet); }
+
+unsigned bench_spudec_process_data(void *this, const void *packet) {
+  spudec_handle_t *spu = this;
+  packet_t copy = *(const packet_t *)packet; /* decoding moves the nibbles */
+  spudec_process_data(spu, &copy);
+  return spu->pal_width * spu->pal_height;
+}
+
+unsigned bench_pal2gray_alpha(void *this) {
+  spudec_handle_t *spu = this;
+  /* gray/alpha of the SPU colors, the background (3) is transparent */
+  static const uint16_t pal[4] = {0x0180, 0x0100, 0x01ff, 0x0000};
+  unsigned stride = (spu->pal_width + 7) & ~7;
+  pal2gray_alpha(pal, spu->pal_image, spu->pal_width, spu->image, spu->aimage,
+                 stride, spu->pal_width, spu->pal_height, 0);
+  spu->width = spu->pal_width;
+  spu->height = spu->pal_height;
+  spu->stride = stride;
+  spu->start_row = spu->pal_start_row;
+  return spu->pal_width * spu->pal_height;
+}
+
+void bench_spudec_cut_image(void *this) { spudec_cut_image(this); }
+#endif
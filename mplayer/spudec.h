@@ -66,6 +66,11 @@ void spudec_packet_clear(struct spu_packet_t *packet);
 void spudec_get_data(void *self, const unsigned char **image,
                      size_t *image_size, unsigned *width, unsigned *height,
                      unsigned *stride, unsigned *start_pts, unsigned *end_pts);
+void spudec_get_position(void *self, unsigned *x, unsigned *y,
+                         unsigned *frame_width, unsigned *frame_height);
+/// Bytes held for packets and images and the number of their allocations.
+/// The done packets are reused, so only larger images allocate again.
+void spudec_get_memory(void *self, size_t *bytes, unsigned long *allocations);
 
 #ifdef __cplusplus
 }
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -39,17 +40,17 @@
 
 char *unrar_executable = NULL;
 
-static FILE *launch_pipe(pid_t *apid, const char *executable, int action,
-                         const char *archive, const char *filename) {
-  if (!executable || access(executable, R_OK | X_OK)) return NULL;
-  if (access(archive, R_OK)) return NULL;
+static int launch_pipe_fd(pid_t *apid, const char *executable, int action,
+                          const char *archive, const char *filename) {
+  if (!executable || access(executable, R_OK | X_OK)) return -1;
+  if (access(archive, R_OK)) return -1;
   {
     int mypipe[2];
     pid_t pid;
 
     if (pipe(mypipe)) {
       mp_msg(MSGT_GLOBAL, MSGL_ERR, "UnRAR: Cannot create pipe.\n");
-      return NULL;
+      return -1;
     }
 
     pid = fork();
@@ -78,7 +79,9 @@ static FILE *launch_pipe(pid_t *apid, const char *executable, int action,
     if (pid < 0) {
       /* The fork failed. Report failure. */
       mp_msg(MSGT_GLOBAL, MSGL_ERR, "UnRAR: Fork failed\n");
-      return NULL;
+      close(mypipe[0]);
+      close(mypipe[1]);
+      return -1;
     }
     /* This is the parent process. Prepare the pipe stream. */
     close(mypipe[1]);
@@ -91,10 +94,35 @@ static FILE *launch_pipe(pid_t *apid, const char *executable, int action,
       mp_msg(MSGT_GLOBAL, MSGL_V,
              "UnRAR: call unrar with command line: %s p -inul -p- %s %s\n",
              executable, archive, filename);
-    return fdopen(mypipe[0], "r");
+    return mypipe[0];
   }
 }
 
+static FILE *launch_pipe(pid_t *apid, const char *executable, int action,
+                         const char *archive, const char *filename) {
+  int fd = launch_pipe_fd(apid, executable, action, archive, filename);
+  FILE *res;
+  if (fd < 0) return NULL;
+  res = fdopen(fd, "r");
+  if (!res) {
+    close(fd);
+    waitpid(*apid, NULL, 0);
+  }
+  return res;
+}
+
+int unrar_exec_open(const char *filename, const char *rarfile, pid_t *pid) {
+  return launch_pipe_fd(pid, unrar_executable, UNRAR_EXTRACT, rarfile,
+                        filename);
+}
+
+int unrar_exec_close(int fd, pid_t pid) {
+  int status = 0;
+  close(fd);
+  pid = waitpid(pid, &status, 0);
+  return !((pid == -1 && errno != ECHILD) || (pid > 0 && status));
+}
+
 #define ALLOC_INCR 1 * 1024 * 1024
 int unrar_exec_get(unsigned char **output, unsigned long *size,
                    const char *filename, const char *rarfile) {
@@ -216,6 +244,63 @@ int unrar_exec_list(const char *rarfile, ArchiveList_struct **list) {
   return file_num;
 }
 
+/* Listings of the archives opened so far. The file size and modification
+ * time tell if an archive has changed since it was listed. */
+typedef struct archive_cache {
+  char *rarfile;
+  off_t size;
+  time_t mtime;
+  int num_files;
+  ArchiveList_struct *list;
+  struct archive_cache *next;
+} archive_cache_t;
+
+static archive_cache_t *archive_cache = NULL;
+
+int unrar_exec_list_cached(const char *rarfile, ArchiveList_struct **list) {
+  struct stat st;
+  archive_cache_t *entry;
+  if (stat(rarfile, &st)) return -1;
+  for (entry = archive_cache; entry; entry = entry->next) {
+    if (!strcmp(entry->rarfile, rarfile)) break;
+  }
+  if (entry && (entry->size != st.st_size || entry->mtime != st.st_mtime)) {
+    unrar_exec_freelist(entry->list);
+    entry->list = NULL;
+    entry->num_files = -2; /* list again */
+  } else if (!entry) {
+    entry = calloc(1, sizeof(archive_cache_t));
+    if (!entry) return unrar_exec_list(rarfile, list);
+    entry->rarfile = strdup(rarfile);
+    if (!entry->rarfile) {
+      free(entry);
+      return unrar_exec_list(rarfile, list);
+    }
+    entry->num_files = -2;
+    entry->next = archive_cache;
+    archive_cache = entry;
+  }
+  if (entry->num_files == -2) {
+    /* failures are cached as well, there is no need to ask unrar again */
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->num_files = unrar_exec_list(rarfile, &entry->list);
+    if (entry->num_files < 0) entry->list = NULL;
+  }
+  *list = entry->list;
+  return entry->num_files;
+}
+
+void unrar_exec_free_cache(void) {
+  while (archive_cache) {
+    archive_cache_t *next = archive_cache->next;
+    unrar_exec_freelist(archive_cache->list);
+    free(archive_cache->rarfile);
+    free(archive_cache);
+    archive_cache = next;
+  }
+}
+
 void unrar_exec_freelist(ArchiveList_struct *list) {
   ArchiveList_struct *tmp;
 
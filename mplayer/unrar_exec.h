@@ -24,6 +24,8 @@
 #ifndef MPLAYER_UNRAR_EXEC_H
 #define MPLAYER_UNRAR_EXEC_H
 
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -51,6 +53,19 @@ int unrar_exec_get(unsigned char **output, unsigned long *size,
 
 int unrar_exec_list(const char *rarfile, ArchiveList_struct **list);
 
+/// Starts extracting filename from rarfile and returns the read end of the
+/// pipe unrar writes the file to, or -1. The file can be read while unrar is
+/// still decompressing it.
+int unrar_exec_open(const char *filename, const char *rarfile, pid_t *pid);
+/// Closes the pipe and waits for unrar. Returns 1 if unrar succeeded.
+int unrar_exec_close(int fd, pid_t pid);
+
+/// Like unrar_exec_list but lists each archive only once. The list belongs
+/// to the cache and must not be freed.
+int unrar_exec_list_cached(const char *rarfile, ArchiveList_struct **list);
+/// Frees the cached archive listings.
+void unrar_exec_free_cache(void);
+
 void unrar_exec_freelist(ArchiveList_struct *list);
 
 #ifdef __cplusplus
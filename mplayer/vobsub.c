@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -47,6 +48,7 @@
 // overridden if slang match any of vobsub streams.
 static int vobsubid = -2;
 int vobsub_id = 0;
+int vobsub_index_cache = 0;
 
 /**
  * @brief Returns the basename substring of a path.
@@ -61,13 +63,76 @@ static const char *mp_basename(const char *path) {
  * The RAR file must have the same basename as the file to open
  **********************************************************************/
 #ifdef CONFIG_UNRAR_EXEC
+/* A file in a RAR archive is read from the unrar pipe through a window, so
+ * the parsing can start while unrar is still decompressing. It can only seek
+ * forward (or back within the window). */
+#define RAR_WINDOW (1024 * 1024)
+
 typedef struct {
   FILE *file;
-  unsigned char *data;
-  unsigned long size;
+  int fd; /* unrar pipe */
+  pid_t pid; /* -1 if the pipe was given to rar_fdopen */
+  int pipe_eof;
+  unsigned char *data; /* window */
+  unsigned long base;  /* file position of data[0] */
+  unsigned long size;  /* bytes in the window */
   unsigned long pos;
 } rar_stream_t;
 
+/* Reads from the pipe until the window contains pos. Returns 0 at the end of
+ * the file. */
+static int rar_fill(rar_stream_t *stream) {
+  while (stream->pos >= stream->base + stream->size) {
+    ssize_t n;
+    if (stream->pipe_eof) return 0;
+    if (stream->size == RAR_WINDOW) {
+      /* everything in the window has been read */
+      stream->base += stream->size;
+      stream->size = 0;
+    }
+    n = read(stream->fd, stream->data + stream->size,
+             RAR_WINDOW - stream->size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      if (n < 0)
+        mp_msg(MSGT_VOBSUB, MSGL_ERR, "UnRAR: read error: %s\n",
+               strerror(errno));
+      stream->pipe_eof = 1;
+      return 0;
+    }
+    stream->size += n;
+  }
+  return 1;
+}
+
+/* Finds the member of the archive to extract for filename p */
+static const char *rar_find_member(const char *p, const char *rar_filename) {
+  ArchiveList_struct *list, *lp;
+  const char *demanded_ext;
+  int i, num_files = unrar_exec_list_cached(rar_filename, &list);
+  /* unrar can still look for the name itself if the listing failed */
+  if (num_files <= 0) return p;
+  for (i = 0, lp = list; i < num_files && lp; i++, lp = lp->next) {
+    if (!strcmp(mp_basename(lp->item.Name), p)) return lp->item.Name;
+  }
+  /* There is no matching filename in the archive. However, sometimes
+   * the files we are looking for have been given arbitrary names in the
+   * archive. Let's look for a file with an exact match in the extension
+   * only. */
+  demanded_ext = strrchr(p, '.');
+  if (demanded_ext) {
+    int demanded_ext_len = strlen(demanded_ext);
+    for (i = 0, lp = list; i < num_files && lp; i++, lp = lp->next) {
+      int name_len = strlen(lp->item.Name);
+      if (name_len >= demanded_ext_len &&
+          !strcasecmp(lp->item.Name + name_len - demanded_ext_len,
+                      demanded_ext))
+        return lp->item.Name;
+    }
+  }
+  return NULL;
+}
+
 static rar_stream_t *rar_open(const char *const filename,
                               const char *const mode) {
   rar_stream_t *stream;
@@ -78,12 +143,12 @@ static rar_stream_t *rar_open(const char *const filename,
   }
   stream = calloc(1, sizeof(rar_stream_t));
   if (stream == NULL) return NULL;
+  stream->fd = -1;
   /* first try normal access */
   stream->file = fopen(filename, mode);
   if (stream->file == NULL) {
     char *rar_filename;
-    const char *p;
-    int rc;
+    const char *p, *member;
     /* Guess the RAR archive filename */
     rar_filename = NULL;
     p = strrchr(filename, '.');
@@ -107,112 +172,100 @@ static rar_stream_t *rar_open(const char *const filename,
     }
     /* get rid of the path if there is any */
     p = mp_basename(filename);
-    rc = unrar_exec_get(&stream->data, &stream->size, p, rar_filename);
-    if (!rc) {
-      /* There is no matching filename in the archive. However, sometimes
-       * the files we are looking for have been given arbitrary names in the
-       * archive. Let's look for a file with an exact match in the extension
-       * only. */
-      int i, num_files, name_len;
-      ArchiveList_struct *list, *lp;
-      num_files = unrar_exec_list(rar_filename, &list);
-      if (num_files > 0) {
-        char *demanded_ext;
-        demanded_ext = strrchr(p, '.');
-        if (demanded_ext) {
-          int demanded_ext_len = strlen(demanded_ext);
-          for (i = 0, lp = list; i < num_files; i++, lp = lp->next) {
-            name_len = strlen(lp->item.Name);
-            if (name_len >= demanded_ext_len &&
-                !strcasecmp(lp->item.Name + name_len - demanded_ext_len,
-                            demanded_ext)) {
-              rc = unrar_exec_get(&stream->data, &stream->size, lp->item.Name,
-                                  rar_filename);
-              if (rc) break;
-            }
-          }
-        }
-        unrar_exec_freelist(list);
-      }
-      if (!rc) {
-        free(rar_filename);
-        free(stream);
-        return NULL;
-      }
+    member = rar_find_member(p, rar_filename);
+    if (member) {
+      stream->data = malloc(RAR_WINDOW);
+      if (stream->data)
+        stream->fd = unrar_exec_open(member, rar_filename, &stream->pid);
     }
-
     free(rar_filename);
-    stream->pos = 0;
+    /* an empty pipe means unrar failed (e.g. there is no such file) */
+    if (stream->fd < 0 || !rar_fill(stream)) {
+      if (stream->fd >= 0) unrar_exec_close(stream->fd, stream->pid);
+      free(stream->data);
+      free(stream);
+      return NULL;
+    }
+  }
+  return stream;
+}
+
+/* Reads a pipe (or any other file descriptor) through the window, so a file
+ * can be parsed while it arrives. Seeking forward reads the data in between. */
+static rar_stream_t *rar_fdopen(int fd) {
+  rar_stream_t *stream = calloc(1, sizeof(rar_stream_t));
+  if (stream == NULL) return NULL;
+  stream->data = malloc(RAR_WINDOW);
+  if (stream->data == NULL) {
+    free(stream);
+    return NULL;
   }
+  stream->fd = fd;
+  stream->pid = -1;
   return stream;
 }
 
 static void rar_close(rar_stream_t *stream) {
   if (stream->file) fclose(stream->file);
+  if (stream->fd >= 0 && stream->pid < 0)
+    close(stream->fd);
+  else if (stream->fd >= 0 && !unrar_exec_close(stream->fd, stream->pid) &&
+           stream->pipe_eof)
+    mp_msg(MSGT_VOBSUB, MSGL_WARN, "UnRAR: extraction failed\n");
   free(stream->data);
   free(stream);
 }
 
 static int rar_eof(rar_stream_t *stream) {
   if (stream->file) return feof(stream->file);
-  return stream->pos >= stream->size;
+  return !rar_fill(stream);
 }
 
-static long rar_tell(rar_stream_t *stream) {
-  if (stream->file) return ftell(stream->file);
+static off_t rar_tell(rar_stream_t *stream) {
+  if (stream->file) return ftello(stream->file);
   return stream->pos;
 }
 
-static int rar_seek(rar_stream_t *stream, long offset, int whence) {
-  if (stream->file) return fseek(stream->file, offset, whence);
+static int rar_seek(rar_stream_t *stream, off_t offset, int whence) {
+  if (stream->file) return fseeko(stream->file, offset, whence);
   switch (whence) {
     case SEEK_SET:
-      if (offset < 0) {
-        errno = EINVAL;
-        return -1;
-      }
-      stream->pos = offset;
       break;
     case SEEK_CUR:
-      if (offset < 0 && stream->pos < (unsigned long)-offset) {
-        errno = EINVAL;
-        return -1;
-      }
-      stream->pos += offset;
-      break;
-    case SEEK_END:
-      if (offset < 0 && stream->size < (unsigned long)-offset) {
-        errno = EINVAL;
-        return -1;
-      }
-      stream->pos = stream->size + offset;
+      offset += stream->pos;
       break;
-    default:
-      errno = EINVAL;
+    default: /* the size is only known at the end of the pipe */
+      errno = ESPIPE;
       return -1;
   }
+  if (offset < 0 || (unsigned long)offset < stream->base) {
+    errno = offset < 0 ? EINVAL : ESPIPE;
+    return -1;
+  }
+  stream->pos = offset;
   return 0;
 }
 
 static int rar_getc(rar_stream_t *stream) {
   if (stream->file) return getc(stream->file);
-  if (rar_eof(stream)) return EOF;
-  return stream->data[stream->pos++];
+  if (!rar_fill(stream)) return EOF;
+  return stream->data[stream->pos++ - stream->base];
 }
 
 static size_t rar_read(void *ptr, size_t size, size_t nmemb,
                        rar_stream_t *stream) {
-  size_t res;
-  unsigned long remain;
+  size_t res = 0, total;
   if (stream->file) return fread(ptr, size, nmemb, stream->file);
-  if (rar_eof(stream)) return 0;
-  res = size * nmemb;
-  remain = stream->size - stream->pos;
-  if (res > remain) res = remain / size * size;
-  memcpy(ptr, stream->data + stream->pos, res);
-  stream->pos += res;
-  res /= size;
-  return res;
+  total = size * nmemb;
+  while (res < total && rar_fill(stream)) {
+    size_t n = stream->base + stream->size - stream->pos;
+    if (n > total - res) n = total - res;
+    memcpy((unsigned char *)ptr + res,
+           stream->data + (stream->pos - stream->base), n);
+    stream->pos += n;
+    res += n;
+  }
+  return size ? res / size : 0;
 }
 
 #else
@@ -220,8 +273,8 @@ typedef FILE rar_stream_t;
 #define rar_open fopen
 #define rar_close fclose
 #define rar_eof feof
-#define rar_tell ftell
-#define rar_seek fseek
+#define rar_tell ftello
+#define rar_seek fseeko
 #define rar_getc getc
 #define rar_read fread
 #endif
@@ -267,26 +320,45 @@ static ssize_t vobsub_getline(char **lineptr, size_t *n, rar_stream_t *stream) {
 
 typedef struct {
   rar_stream_t *stream;
+  uint64_t end; /* stop reading here, e.g. at the end of a VOB in an ISO */
   unsigned int pts;
+  int has_pts; /* the last packet had a PTS */
   int aid;
   unsigned char *packet;
   unsigned int packet_reserve;
   unsigned int packet_size;
+  uint64_t packet_pos; /* file position of the packet data */
   int padding_was_here;
   int merge;
+  /* DVD navigation (PCI) packet */
+  int vobu_valid;
+  unsigned int vobu_s_ptm, vobu_e_ptm;
 } mpeg_t;
 
-static mpeg_t *mpeg_open(const char *filename) {
+static mpeg_t *mpeg_new(void) {
   mpeg_t *res = malloc(sizeof(mpeg_t));
-  int err = res == NULL;
-  if (!err) {
+  if (res) {
+    res->end = UINT64_MAX;
     res->pts = 0;
+    res->has_pts = 0;
     res->aid = -1;
     res->packet = NULL;
     res->packet_size = 0;
     res->packet_reserve = 0;
+    res->packet_pos = 0;
     res->padding_was_here = 1;
     res->merge = 0;
+    res->vobu_valid = 0;
+    res->vobu_s_ptm = res->vobu_e_ptm = 0;
+    res->stream = NULL;
+  }
+  return res;
+}
+
+static mpeg_t *mpeg_open(const char *filename) {
+  mpeg_t *res = mpeg_new();
+  int err = res == NULL;
+  if (!err) {
     res->stream = rar_open(filename, "rb");
     err = res->stream == NULL;
     if (err) perror("fopen Vobsub file failed");
@@ -295,22 +367,38 @@ static mpeg_t *mpeg_open(const char *filename) {
   return err ? NULL : res;
 }
 
+/* The stream can only be read forward, which is all mpeg_run needs */
+static mpeg_t *mpeg_fdopen(int fd) {
+  mpeg_t *res = mpeg_new();
+  if (res) {
+    res->stream = rar_fdopen(fd);
+    if (res->stream == NULL) {
+      free(res);
+      res = NULL;
+    }
+  }
+  return res;
+}
+
 static void mpeg_free(mpeg_t *mpeg) {
   free(mpeg->packet);
   if (mpeg->stream) rar_close(mpeg->stream);
   free(mpeg);
 }
 
-static int mpeg_eof(mpeg_t *mpeg) { return rar_eof(mpeg->stream); }
-
 static uint64_t mpeg_tell(mpeg_t *mpeg) { return rar_tell(mpeg->stream); }
 
+static int mpeg_eof(mpeg_t *mpeg) {
+  return rar_eof(mpeg->stream) || mpeg_tell(mpeg) >= mpeg->end;
+}
+
 static int mpeg_run(mpeg_t *mpeg) {
-  unsigned int len, idx, version;
-  int c;
+  unsigned int len, version, pts = 0;
+  uint64_t idx;
+  int c, has_pts = 0;
   /* Goto start of a packet, it starts with 0x000001?? */
   const unsigned char wanted[] = {0, 0, 1};
-  unsigned char buf[5];
+  unsigned char buf[21];
 
   mpeg->aid = -1;
   mpeg->packet_size = 0;
@@ -363,7 +451,8 @@ static int mpeg_run(mpeg_t *mpeg) {
         /* Do we need this? */
         abort();
       } else if ((c & 0xc0) == 0x80) { /* System-2 (.VOB) stream */
-        unsigned int pts_flags, hdrlen, dataidx;
+        unsigned int pts_flags, hdrlen;
+        uint64_t dataidx;
         c = rar_getc(mpeg->stream);
         if (c < 0) return -1;
         pts_flags = c;
@@ -373,9 +462,10 @@ static int mpeg_run(mpeg_t *mpeg) {
         dataidx = mpeg_tell(mpeg) + hdrlen;
         if (dataidx > idx + len) {
           mp_msg(MSGT_VOBSUB, MSGL_ERR,
-                 "Invalid header length: %d (total length: %d, idx: %d, "
-                 "dataidx: %d)\n",
-                 hdrlen, len, idx, dataidx);
+                 "Invalid header length: %u (total length: %u, idx: %llu, "
+                 "dataidx: %llu)\n",
+                 hdrlen, len, (unsigned long long)idx,
+                 (unsigned long long)dataidx);
           return -1;
         }
         if ((pts_flags & 0xc0) == 0x80) {
@@ -385,21 +475,34 @@ static int mpeg_run(mpeg_t *mpeg) {
             mp_msg(MSGT_VOBSUB, MSGL_ERR,
                    "vobsub PTS error: 0x%02x %02x%02x %02x%02x \n", buf[0],
                    buf[1], buf[2], buf[3], buf[4]);
-            mpeg->pts = 0;
+            pts = 0;
           } else
-            mpeg->pts = ((buf[0] & 0x0e) << 29 | buf[1] << 22 |
-                         (buf[2] & 0xfe) << 14 | buf[3] << 7 | (buf[4] >> 1));
+            pts = ((buf[0] & 0x0e) << 29 | buf[1] << 22 |
+                   (buf[2] & 0xfe) << 14 | buf[3] << 7 | (buf[4] >> 1));
+          has_pts = 1;
         } else /* if ((pts_flags & 0xc0) == 0xc0) */ {
           /* what's this? */
           /* abort(); */
         }
-        rar_seek(mpeg->stream, dataidx, SEEK_SET);
+        /* relative seeks, the VOBs in an ISO image may lie beyond 4 GiB */
+        rar_seek(mpeg->stream, (off_t)(dataidx - mpeg_tell(mpeg)), SEEK_CUR);
         mpeg->aid = rar_getc(mpeg->stream);
         if (mpeg->aid < 0) {
           mp_msg(MSGT_VOBSUB, MSGL_ERR, "Bogus aid %d\n", mpeg->aid);
           return -1;
         }
-        mpeg->packet_size = len - ((unsigned int)mpeg_tell(mpeg) - idx);
+        if ((mpeg->aid & 0xe0) != 0x20) {
+          /* not a subtitle (e.g. AC3 audio in a VOB), skip it */
+          if (rar_seek(mpeg->stream, (off_t)(idx + len - mpeg_tell(mpeg)),
+                       SEEK_CUR))
+            return -1;
+          break;
+        }
+        /* only subtitle packets may set the PTS, the continuation packets
+         * of a SPU have none */
+        mpeg->has_pts = has_pts;
+        if (has_pts) mpeg->pts = pts;
+        mpeg->packet_size = len - (unsigned int)(mpeg_tell(mpeg) - idx);
         if (mpeg->packet_reserve < mpeg->packet_size) {
           free(mpeg->packet);
           mpeg->packet = malloc(mpeg->packet_size);
@@ -411,6 +514,7 @@ static int mpeg_run(mpeg_t *mpeg) {
           mpeg->packet_size = 0;
           return -1;
         }
+        mpeg->packet_pos = mpeg_tell(mpeg);
         if (rar_read(mpeg->packet, mpeg->packet_size, 1, mpeg->stream) != 1) {
           mp_msg(MSGT_VOBSUB, MSGL_ERR, "fread failure");
           mpeg->packet_size = 0;
@@ -419,6 +523,25 @@ static int mpeg_run(mpeg_t *mpeg) {
         idx = len;
       }
       break;
+    case 0xbb: /* System header */
+      if (rar_read(buf, 2, 1, mpeg->stream) != 1) return -1;
+      len = buf[0] << 8 | buf[1];
+      if (len > 0 && rar_seek(mpeg->stream, len, SEEK_CUR)) return -1;
+      break;
+    case 0xbf: /* Private stream 2, the DVD navigation packets */
+      if (rar_read(buf, 2, 1, mpeg->stream) != 1) return -1;
+      len = buf[0] << 8 | buf[1];
+      if (len >= sizeof(buf)) {
+        if (rar_read(buf, sizeof(buf), 1, mpeg->stream) != 1) return -1;
+        len -= sizeof(buf);
+        if (buf[0] == 0) { /* PCI: VOBU start and end PTM */
+          mpeg->vobu_s_ptm = AV_RB32(buf + 1 + 0x0c);
+          mpeg->vobu_e_ptm = AV_RB32(buf + 1 + 0x10);
+          mpeg->vobu_valid = 1;
+        }
+      }
+      if (len > 0 && rar_seek(mpeg->stream, len, SEEK_CUR)) return -1;
+      break;
     case 0xbe: /* Padding */
       if (rar_read(buf, 2, 1, mpeg->stream) != 1) return -1;
       len = buf[0] << 8 | buf[1];
@@ -447,8 +570,9 @@ static int mpeg_run(mpeg_t *mpeg) {
 typedef struct {
   unsigned int pts100;
   uint64_t filepos;
+  uint64_t datapos; /* of the data in the .sub file */
   unsigned int size;
-  unsigned char *data;
+  unsigned char *data; /* NULL until read if the index came from the cache */
 } packet_t;
 
 typedef struct {
@@ -457,11 +581,13 @@ typedef struct {
   unsigned int packets_reserve;
   unsigned int packets_size;
   unsigned int current_index;
+  unsigned int released; /* packets before it have no data any more */
 } packet_queue_t;
 
 static void packet_construct(packet_t *pkt) {
   pkt->pts100 = 0;
   pkt->filepos = 0;
+  pkt->datapos = 0;
   pkt->size = 0;
   pkt->data = NULL;
 }
@@ -474,6 +600,7 @@ static void packet_queue_construct(packet_queue_t *queue) {
   queue->packets_reserve = 0;
   queue->packets_size = 0;
   queue->current_index = 0;
+  queue->released = 0;
 }
 
 static void packet_queue_destroy(packet_queue_t *queue) {
@@ -552,6 +679,12 @@ typedef struct {
   unsigned int spu_streams_size;
   unsigned int spu_streams_current;
   unsigned int spu_valid_streams_size;
+  FILE *sub_file; /* to read the packets listed in the index cache */
+  mpeg_t *sub_stream; /* the .sub data if it is read while converting */
+  long last_pts_diff;
+  /* packet data in memory */
+  uint64_t data_bytes, data_peak;
+  unsigned long data_allocations;
 } vobsub_t;
 
 /* Make sure that the spu stream idx exists. */
@@ -803,6 +936,14 @@ static int vobsub_parse_one_line(vobsub_t *vob, rar_stream_t *fd,
 int vobsub_parse_ifo(void *this, const char *const name, unsigned int *palette,
                      unsigned int *width, unsigned int *height, int force,
                      int sid, char *langid) {
+  return vobsub_parse_ifo_at(this, name, 0, palette, width, height, force, sid,
+                             langid);
+}
+
+int vobsub_parse_ifo_at(void *this, const char *const name, uint64_t offset,
+                        unsigned int *palette, unsigned int *width,
+                        unsigned int *height, int force, int sid,
+                        char *langid) {
   vobsub_t *vob = this;
   int res = -1;
   rar_stream_t *fd = rar_open(name, "rb");
@@ -810,7 +951,8 @@ int vobsub_parse_ifo(void *this, const char *const name, unsigned int *palette,
     // parse IFO header
     unsigned char block[0x800];
     const char *const ifo_magic = "DVDVIDEO-VTS";
-    if (rar_read(block, sizeof(block), 1, fd) != 1) {
+    if (rar_seek(fd, offset, SEEK_SET) ||
+        rar_read(block, sizeof(block), 1, fd) != 1) {
       if (force)
         mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Can't read IFO header\n");
     } else if (memcmp(block, ifo_magic, strlen(ifo_magic) + 1))
@@ -845,7 +987,7 @@ int vobsub_parse_ifo(void *this, const char *const name, unsigned int *palette,
         langid[1] = tmp[1];
         langid[2] = 0;
       }
-      if (rar_seek(fd, pgci_sector * sizeof(block), SEEK_SET) ||
+      if (rar_seek(fd, offset + pgci_sector * sizeof(block), SEEK_SET) ||
           rar_read(block, sizeof(block), 1, fd) != 1)
         mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Can't read IFO PGCI\n");
       else {
@@ -865,8 +1007,339 @@ int vobsub_parse_ifo(void *this, const char *const name, unsigned int *palette,
   return res;
 }
 
+/**********************************************************************
+ * Index cache
+ * <subname>.v2sidx holds the parsed index and the packet positions of the
+ * .sub scan, so repeated runs skip both. It is only valid for the .idx, .sub
+ * and .ifo files with the size and modification time it was written for.
+ * Layout (native byte order, 8 byte aligned): header, the idx header text,
+ * then per stream its header, id and packet records.
+ **********************************************************************/
+
+#define V2SIDX_MAGIC "V2SIDX\0\1"
+#define V2SIDX_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+typedef struct {
+  uint64_t size, mtime;
+} v2sidx_file_t;
+
+typedef struct {
+  char magic[8];
+  uint32_t byte_order; /* 0x01020304 */
+  uint32_t streams;
+  v2sidx_file_t idx, sub, ifo;
+  uint32_t palette[16];
+  uint32_t have_palette;
+  uint32_t orig_frame_width, orig_frame_height;
+  uint32_t origin_x, origin_y;
+  uint32_t extradata_len;
+} v2sidx_header_t;
+
+typedef struct {
+  uint32_t packets;
+  uint32_t id_len;
+} v2sidx_stream_t;
+
+typedef struct {
+  uint64_t datapos;
+  uint32_t pts100;
+  uint32_t size;
+} v2sidx_packet_t;
+
+static void v2sidx_stat(const char *name, v2sidx_file_t *file) {
+  struct stat st;
+  if (stat(name, &st)) {
+    file->size = file->mtime = 0;
+  } else {
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+  }
+}
+
+/* Fills in the file keys. Fails unless .idx and .sub are plain files (e.g.
+ * not in a RAR archive). */
+static int v2sidx_key(const char *name, const char *ifo, char *buf,
+                      v2sidx_header_t *hdr) {
+  memset(hdr, 0, sizeof(*hdr));
+  memcpy(hdr->magic, V2SIDX_MAGIC, sizeof(hdr->magic));
+  hdr->byte_order = 0x01020304;
+  sprintf(buf, "%s.idx", name);
+  v2sidx_stat(buf, &hdr->idx);
+  sprintf(buf, "%s.sub", name);
+  v2sidx_stat(buf, &hdr->sub);
+  if (!ifo) sprintf(buf, "%s.ifo", name);
+  v2sidx_stat(ifo ? ifo : buf, &hdr->ifo);
+  return hdr->idx.size && hdr->sub.size ? 0 : -1;
+}
+
+/* Loads the cache into the (empty) vob. The packet data is read on demand
+ * from the .sub file. */
+static int vobsub_load_index(vobsub_t *vob, const char *name, const char *ifo,
+                             unsigned char **extradata,
+                             unsigned int *extradata_len) {
+  v2sidx_header_t key;
+  const v2sidx_header_t *hdr;
+  const unsigned char *map, *p, *end;
+  struct stat st;
+  unsigned int i, j;
+  int fd, res = -1;
+  char *buf = malloc(strlen(name) + 8);
+  if (buf == NULL) return -1;
+  if (v2sidx_key(name, ifo, buf, &key) < 0) {
+    free(buf);
+    return -1;
+  }
+  sprintf(buf, "%s.v2sidx", name);
+  fd = open(buf, O_RDONLY);
+  free(buf);
+  if (fd < 0) return -1;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(v2sidx_header_t)) {
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return -1;
+  hdr = (const v2sidx_header_t *)map;
+  end = map + st.st_size;
+  if (memcmp(hdr->magic, key.magic, sizeof(key.magic)) ||
+      hdr->byte_order != key.byte_order ||
+      memcmp(&hdr->idx, &key.idx, 3 * sizeof(v2sidx_file_t)) ||
+      hdr->streams > 32)
+    goto out;
+  p = map + V2SIDX_ALIGN(sizeof(*hdr));
+  if ((uint64_t)(end - p) < V2SIDX_ALIGN(hdr->extradata_len)) goto out;
+  *extradata = malloc(hdr->extradata_len + 1);
+  if (*extradata == NULL) goto out;
+  memcpy(*extradata, p, hdr->extradata_len);
+  (*extradata)[hdr->extradata_len] = 0;
+  *extradata_len = hdr->extradata_len;
+  p += V2SIDX_ALIGN(hdr->extradata_len);
+  if (hdr->streams && vobsub_ensure_spu_stream(vob, hdr->streams - 1) < 0)
+    goto out;
+  for (i = 0; i < hdr->streams; ++i) {
+    const v2sidx_stream_t *stream = (const v2sidx_stream_t *)p;
+    const v2sidx_packet_t *rec;
+    packet_queue_t *queue = vob->spu_streams + i;
+    if ((uint64_t)(end - p) < sizeof(*stream) + V2SIDX_ALIGN(stream->id_len))
+      goto out;
+    p += sizeof(*stream);
+    if (stream->id_len &&
+        vobsub_add_id(vob, (const char *)p, stream->id_len, i) < 0)
+      goto out;
+    p += V2SIDX_ALIGN(stream->id_len);
+    if ((uint64_t)(end - p) < (uint64_t)stream->packets * sizeof(*rec))
+      goto out;
+    if (stream->packets) {
+      /* packet_queue_ensure only grows one step at a time */
+      queue->packets = malloc(stream->packets * sizeof(packet_t));
+      if (queue->packets == NULL) goto out;
+      queue->packets_reserve = stream->packets;
+    }
+    rec = (const v2sidx_packet_t *)p;
+    for (j = 0; j < stream->packets; ++j) {
+      packet_t *pkt = queue->packets + j;
+      packet_construct(pkt);
+      pkt->pts100 = rec[j].pts100;
+      pkt->datapos = rec[j].datapos;
+      pkt->size = rec[j].size;
+    }
+    queue->packets_size = stream->packets;
+    p += stream->packets * sizeof(*rec);
+  }
+  memcpy(vob->palette, hdr->palette, sizeof(vob->palette));
+  vob->have_palette = hdr->have_palette;
+  vob->orig_frame_width = hdr->orig_frame_width;
+  vob->orig_frame_height = hdr->orig_frame_height;
+  vob->origin_x = hdr->origin_x;
+  vob->origin_y = hdr->origin_y;
+  res = 0;
+out:
+  munmap((void *)map, st.st_size);
+  if (res < 0) {
+    /* start over with a clean vob */
+    free(*extradata);
+    *extradata = NULL;
+    *extradata_len = 0;
+    if (vob->spu_streams) {
+      while (vob->spu_streams_size--) {
+        free(vob->spu_streams[vob->spu_streams_size].id);
+        packet_queue_destroy(vob->spu_streams + vob->spu_streams_size);
+      }
+      free(vob->spu_streams);
+      vob->spu_streams = NULL;
+    }
+    vob->spu_streams_size = vob->spu_streams_current = 0;
+    mp_msg(MSGT_VOBSUB, MSGL_V, "VobSub: index cache of %s is stale\n", name);
+  }
+  return res;
+}
+
+static int v2sidx_write(FILE *f, const void *data, size_t size) {
+  static const char zero[8];
+  size_t pad = V2SIDX_ALIGN(size) - size;
+  return fwrite(data, 1, size, f) == size && fwrite(zero, 1, pad, f) == pad
+             ? 0
+             : -1;
+}
+
+/* Writes the cache. Only the header lines of the index are kept since the
+ * time stamps are in the packet records. */
+static void vobsub_save_index(vobsub_t *vob, const char *name, const char *ifo,
+                              const unsigned char *extradata,
+                              unsigned int extradata_len) {
+  v2sidx_header_t hdr;
+  char *buf, *tmp;
+  const unsigned char *line, *next, *end = extradata + extradata_len;
+  unsigned char *header_lines;
+  unsigned int i, j, len = 0;
+  FILE *f;
+  int err;
+  buf = malloc(strlen(name) + 16);
+  tmp = malloc(strlen(name) + 16);
+  header_lines = malloc(extradata_len + 1);
+  if (!buf || !tmp || !header_lines || v2sidx_key(name, ifo, buf, &hdr) < 0)
+    goto out;
+  for (line = extradata; line < end; line = next) {
+    next = memchr(line, '\n', end - line);
+    next = next ? next + 1 : end;
+    if (strncmp((const char *)line, "timestamp:", 10)) {
+      memcpy(header_lines + len, line, next - line);
+      len += next - line;
+    }
+  }
+  hdr.streams = vob->spu_streams_size;
+  memcpy(hdr.palette, vob->palette, sizeof(hdr.palette));
+  hdr.have_palette = vob->have_palette;
+  hdr.orig_frame_width = vob->orig_frame_width;
+  hdr.orig_frame_height = vob->orig_frame_height;
+  hdr.origin_x = vob->origin_x;
+  hdr.origin_y = vob->origin_y;
+  hdr.extradata_len = len;
+  /* write to a temporary file so other runs never see a partial cache */
+  sprintf(tmp, "%s.v2sidx.%d", name, (int)getpid());
+  f = fopen(tmp, "wb");
+  if (f == NULL) goto out;
+  err = v2sidx_write(f, &hdr, sizeof(hdr)) ||
+        v2sidx_write(f, header_lines, len);
+  for (i = 0; !err && i < vob->spu_streams_size; ++i) {
+    packet_queue_t *queue = vob->spu_streams + i;
+    v2sidx_stream_t stream;
+    stream.packets = queue->packets_size;
+    stream.id_len = queue->id ? strlen(queue->id) : 0;
+    err = v2sidx_write(f, &stream, sizeof(stream)) ||
+          v2sidx_write(f, queue->id, stream.id_len);
+    for (j = 0; !err && j < queue->packets_size; ++j) {
+      v2sidx_packet_t rec;
+      rec.datapos = queue->packets[j].datapos;
+      rec.pts100 = queue->packets[j].pts100;
+      rec.size = queue->packets[j].size;
+      err = fwrite(&rec, sizeof(rec), 1, f) != 1;
+    }
+  }
+  err = fclose(f) || err;
+  sprintf(buf, "%s.v2sidx", name);
+  if (err || rename(tmp, buf)) {
+    mp_msg(MSGT_VOBSUB, MSGL_WARN, "VobSub: Can't write index cache %s\n",
+           buf);
+    unlink(tmp);
+  }
+out:
+  free(header_lines);
+  free(tmp);
+  free(buf);
+}
+
+static void vobsub_count_data(vobsub_t *vob, unsigned int size) {
+  vob->data_bytes += size;
+  if (vob->data_bytes > vob->data_peak) vob->data_peak = vob->data_bytes;
+  ++vob->data_allocations;
+}
+
+/* Reads the data of a packet listed in the index cache */
+static int vobsub_load_packet(vobsub_t *vob, packet_t *pkt) {
+  if (pkt->data || !pkt->size) return 0;
+  pkt->data = malloc(pkt->size);
+  if (pkt->data == NULL) return -1;
+  if (!vob->sub_file || fseeko(vob->sub_file, pkt->datapos, SEEK_SET) ||
+      fread(pkt->data, pkt->size, 1, vob->sub_file) != 1) {
+    mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Can't read packet at %" PRIu64
+           "\n", pkt->datapos);
+    free(pkt->data);
+    pkt->data = NULL;
+    return -1;
+  }
+  vobsub_count_data(vob, pkt->size);
+  return 0;
+}
+
+/* Counts the streams with packets and rewinds them */
+static void vobsub_finish_streams(vobsub_t *vob) {
+  vob->spu_streams_current = vob->spu_streams_size;
+  while (vob->spu_streams_current-- > 0) {
+    vob->spu_streams[vob->spu_streams_current].current_index = 0;
+    if (vobsubid == vob->spu_streams_current ||
+        vob->spu_streams[vob->spu_streams_current].packets_size > 0)
+      ++vob->spu_valid_streams_size;
+  }
+}
+
+/* Gives the packet mpeg_run has just read from pos to the index entry it
+ * belongs to. Returns that entry or NULL if the packet is not used. */
+static packet_t *vobsub_add_packet(vobsub_t *vob, mpeg_t *mpg, uint64_t pos) {
+  unsigned int sid;
+  packet_queue_t *queue;
+  packet_t *pkt;
+  if (!mpg->packet_size || (mpg->aid & 0xe0) != 0x20) return NULL;
+  sid = mpg->aid & 0x1f;
+  if (vobsub_ensure_spu_stream(vob, sid) < 0) {
+    mp_msg(MSGT_VOBSUB, MSGL_WARN, "don't know what to do with subtitle #%u\n",
+           sid);
+    return NULL;
+  }
+  queue = vob->spu_streams + sid;
+  /* get the packet to fill */
+  if (queue->packets_size == 0 && packet_queue_grow(queue) < 0) abort();
+  while (queue->current_index + 1 < queue->packets_size &&
+         queue->packets[queue->current_index + 1].filepos <= pos)
+    ++queue->current_index;
+  if (queue->current_index >= queue->packets_size) return NULL;
+  if (queue->packets[queue->current_index].data) {
+    /* insert a new packet and fix the PTS ! */
+    packet_queue_insert(queue);
+    queue->packets[queue->current_index].pts100 =
+        mpg->pts + vob->last_pts_diff;
+  }
+  pkt = queue->packets + queue->current_index;
+  if (pkt->pts100 == UINT_MAX) return NULL;
+  if (queue->packets_size > 1)
+    vob->last_pts_diff = pkt->pts100 - mpg->pts;
+  else
+    pkt->pts100 = mpg->pts;
+  if (mpg->merge && queue->current_index > 0) {
+    packet_t *last = &queue->packets[queue->current_index - 1];
+    pkt->pts100 = last->pts100;
+  }
+  mpg->merge = 0;
+  /* FIXME: should not use mpg_sub internal informations, make a copy */
+  pkt->data = mpg->packet;
+  pkt->size = mpg->packet_size;
+  pkt->datapos = mpg->packet_pos;
+  vobsub_count_data(vob, pkt->size);
+  mpg->packet = NULL;
+  mpg->packet_reserve = 0;
+  mpg->packet_size = 0;
+  return pkt;
+}
+
 void *vobsub_open(const char *const name, const char *const ifo,
                   const int force, unsigned int y_threshold, void **spu) {
+  return vobsub_open_stream(name, ifo, -1, force, y_threshold, spu);
+}
+
+void *vobsub_open_stream(const char *const name, const char *const ifo,
+                         int sub_fd, const int force, unsigned int y_threshold,
+                         void **spu) {
   unsigned char *extradata = NULL;
   unsigned int extradata_len = 0;
   vobsub_t *vob = calloc(1, sizeof(vobsub_t));
@@ -878,6 +1351,31 @@ void *vobsub_open(const char *const name, const char *const ifo,
     if (buf) {
       rar_stream_t *fd;
       mpeg_t *mpg;
+      if (sub_fd < 0 && vobsub_index_cache &&
+          vobsub_load_index(vob, name, ifo, &extradata, &extradata_len) == 0) {
+        const char *line;
+        for (line = (const char *)extradata; line; line = strchr(line, '\n')) {
+          while (*line == '\n') ++line;
+          if (strncmp("langidx:", line, 8) == 0) vobsub_set_lang(line);
+        }
+        strcpy(buf, name);
+        strcat(buf, ".sub");
+        vob->sub_file = fopen(buf, "rb");
+        if (spu)
+          *spu = spudec_new_scaled(vob->palette, vob->orig_frame_width,
+                                   vob->orig_frame_height, extradata,
+                                   extradata_len, y_threshold);
+        free(extradata);
+        free(buf);
+        if (vob->sub_file == NULL) {
+          perror("fopen Vobsub file failed");
+          vobsub_close(vob);
+          return NULL;
+        }
+        vobsub_finish_streams(vob);
+        mp_msg(MSGT_VOBSUB, MSGL_V, "VobSub: using index cache\n");
+        return vob;
+      }
       /* read in the info file */
       if (!ifo) {
         strcpy(buf, name);
@@ -908,22 +1406,25 @@ void *vobsub_open(const char *const name, const char *const ifo,
         *spu = spudec_new_scaled(vob->palette, vob->orig_frame_width,
                                  vob->orig_frame_height, extradata,
                                  extradata_len, y_threshold);
-      free(extradata);
 
       /* read the indexed mpeg_stream */
       strcpy(buf, name);
       strcat(buf, ".sub");
-      mpg = mpeg_open(buf);
-      if (mpg == NULL) {
+      mpg = sub_fd < 0 ? mpeg_open(buf) : mpeg_fdopen(sub_fd);
+      if (mpg && sub_fd >= 0) {
+        /* vobsub_get_next_packet reads the packets as they arrive */
+        vob->sub_stream = mpg;
+        vobsub_finish_streams(vob);
+      } else if (mpg == NULL) {
         if (force)
           mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Can't open SUB file\n");
         else {
+          free(extradata);
           free(buf);
           free(vob);
           return NULL;
         }
       } else {
-        long last_pts_diff = 0;
         while (!mpeg_eof(mpg)) {
           uint64_t pos = mpeg_tell(mpg);
           if (mpeg_run(mpg) < 0) {
@@ -931,69 +1432,27 @@ void *vobsub_open(const char *const name, const char *const ifo,
               mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: mpeg_run error\n");
             break;
           }
-          if (mpg->packet_size) {
-            if ((mpg->aid & 0xe0) == 0x20) {
-              unsigned int sid = mpg->aid & 0x1f;
-              if (vobsub_ensure_spu_stream(vob, sid) >= 0) {
-                packet_queue_t *queue = vob->spu_streams + sid;
-                /* get the packet to fill */
-                if (queue->packets_size == 0 && packet_queue_grow(queue) < 0)
-                  abort();
-                while (queue->current_index + 1 < queue->packets_size &&
-                       queue->packets[queue->current_index + 1].filepos <= pos)
-                  ++queue->current_index;
-                if (queue->current_index < queue->packets_size) {
-                  packet_t *pkt;
-                  if (queue->packets[queue->current_index].data) {
-                    /* insert a new packet and fix the PTS ! */
-                    packet_queue_insert(queue);
-                    queue->packets[queue->current_index].pts100 =
-                        mpg->pts + last_pts_diff;
-                  }
-                  pkt = queue->packets + queue->current_index;
-                  if (pkt->pts100 != UINT_MAX) {
-                    if (queue->packets_size > 1)
-                      last_pts_diff = pkt->pts100 - mpg->pts;
-                    else
-                      pkt->pts100 = mpg->pts;
-                    if (mpg->merge && queue->current_index > 0) {
-                      packet_t *last =
-                          &queue->packets[queue->current_index - 1];
-                      pkt->pts100 = last->pts100;
-                    }
-                    mpg->merge = 0;
-                    /* FIXME: should not use mpg_sub internal informations, make
-                     * a copy */
-                    pkt->data = mpg->packet;
-                    pkt->size = mpg->packet_size;
-                    mpg->packet = NULL;
-                    mpg->packet_reserve = 0;
-                    mpg->packet_size = 0;
-                  }
-                }
-              } else
-                mp_msg(MSGT_VOBSUB, MSGL_WARN,
-                       "don't know what to do with subtitle #%u\n", sid);
-            }
-          }
-        }
-        vob->spu_streams_current = vob->spu_streams_size;
-        while (vob->spu_streams_current-- > 0) {
-          vob->spu_streams[vob->spu_streams_current].current_index = 0;
-          if (vobsubid == vob->spu_streams_current ||
-              vob->spu_streams[vob->spu_streams_current].packets_size > 0)
-            ++vob->spu_valid_streams_size;
+          vobsub_add_packet(vob, mpg, pos);
         }
+        vobsub_finish_streams(vob);
         mpeg_free(mpg);
+        if (vobsub_index_cache)
+          vobsub_save_index(vob, name, ifo, extradata, extradata_len);
       }
+      free(extradata);
       free(buf);
     }
   }
+#ifdef CONFIG_UNRAR_EXEC
+  unrar_exec_free_cache();
+#endif
   return vob;
 }
 
 void vobsub_close(void *this) {
   vobsub_t *vob = this;
+  if (vob->sub_file) fclose(vob->sub_file);
+  if (vob->sub_stream) mpeg_free(vob->sub_stream);
   if (vob->spu_streams) {
     while (vob->spu_streams_size--)
       packet_queue_destroy(vob->spu_streams + vob->spu_streams_size);
@@ -1002,6 +1461,22 @@ void vobsub_close(void *this) {
   free(vob);
 }
 
+void vobsub_get_memory(void *vobhandle, uint64_t *bytes, uint64_t *peak,
+                       unsigned long *allocations) {
+  vobsub_t *vob = vobhandle;
+  *bytes = vob->data_bytes;
+  *peak = vob->data_peak;
+  *allocations = vob->data_allocations;
+}
+
+unsigned int vobsub_get_packet_count(void *vobhandle) {
+  vobsub_t *vob = vobhandle;
+  if (vob->spu_streams && 0 <= vobsub_id &&
+      (unsigned)vobsub_id < vob->spu_streams_size)
+    return vob->spu_streams[vobsub_id].packets_size;
+  return 0;
+}
+
 unsigned int vobsub_get_indexes_count(void *vobhandle) {
   vobsub_t *vob = vobhandle;
   return vob->spu_valid_streams_size;
@@ -1099,6 +1574,7 @@ int vobsub_get_packet(void *vobhandle, float pts, void **data, int *timestamp) {
       if (pkt->pts100 != UINT_MAX)
         if (pkt->pts100 <= pts100) {
           ++queue->current_index;
+          if (vobsub_load_packet(vob, pkt) < 0) return -1;
           *data = pkt->data;
           *timestamp = pkt->pts100;
           return pkt->size;
@@ -1111,14 +1587,51 @@ int vobsub_get_packet(void *vobhandle, float pts, void **data, int *timestamp) {
   return -1;
 }
 
+/* Reads the .sub data up to the next packet of the selected stream. Only the
+ * last packet of every stream is kept, the ones before have been handed out
+ * (or belong to other streams). */
+static int vobsub_stream_next_packet(vobsub_t *vob, void **data,
+                                     int *timestamp) {
+  mpeg_t *mpg = vob->sub_stream;
+  while (!mpeg_eof(mpg)) {
+    uint64_t pos = mpeg_tell(mpg);
+    packet_queue_t *queue;
+    packet_t *pkt;
+    if (mpeg_run(mpg) < 0) {
+      if (!mpeg_eof(mpg)) {
+        mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: mpeg_run error\n");
+        return -1;
+      }
+      break;
+    }
+    pkt = vobsub_add_packet(vob, mpg, pos);
+    if (pkt == NULL) continue;
+    queue = vob->spu_streams + (mpg->aid & 0x1f);
+    while (queue->released < queue->current_index) {
+      packet_t *done = queue->packets + queue->released++;
+      if (done->data) vob->data_bytes -= done->size;
+      free(done->data);
+      done->data = NULL;
+    }
+    if ((mpg->aid & 0x1f) == vobsub_id) {
+      *data = pkt->data;
+      *timestamp = pkt->pts100;
+      return pkt->size;
+    }
+  }
+  return -1;
+}
+
 int vobsub_get_next_packet(void *vobhandle, void **data, int *timestamp) {
   vobsub_t *vob = vobhandle;
+  if (vob->sub_stream) return vobsub_stream_next_packet(vob, data, timestamp);
   if (vob->spu_streams && 0 <= vobsub_id &&
       (unsigned)vobsub_id < vob->spu_streams_size) {
     packet_queue_t *queue = vob->spu_streams + vobsub_id;
     if (queue->current_index < queue->packets_size) {
       packet_t *pkt = queue->packets + queue->current_index;
       ++queue->current_index;
+      if (vobsub_load_packet(vob, pkt) < 0) return -1;
       *data = pkt->data;
       *timestamp = pkt->pts100;
       return pkt->size;
@@ -1149,3 +1662,116 @@ void vobsub_reset(void *vobhandle) {
     while (n-- > 0) vob->spu_streams[n].current_index = 0;
   }
 }
+
+/**********************************************************************
+ * Subtitles straight from a MPEG program stream (DVD VOB files)
+ **********************************************************************/
+
+typedef struct {
+  mpeg_t *mpeg;
+  unsigned int sid;
+  unsigned int pts;       /* of the last packet of the stream */
+  int have_vobu;          /* a navigation packet has been seen */
+  unsigned int vobu_e_ptm; /* end of the last VOBU */
+  int64_t pts_offset;     /* keeps the time stamps continuous from 0 */
+} ps_reader_t;
+
+void *vobsub_ps_open(unsigned int sid) {
+  ps_reader_t *ps = calloc(1, sizeof(ps_reader_t));
+  if (ps) ps->sid = sid;
+  return ps;
+}
+
+int vobsub_ps_set_file(void *this, const char *filename, uint64_t offset,
+                       uint64_t length) {
+  ps_reader_t *ps = this;
+  if (ps->mpeg) mpeg_free(ps->mpeg);
+  ps->mpeg = mpeg_open(filename);
+  if (ps->mpeg == NULL) return -1;
+#ifdef CONFIG_UNRAR_EXEC
+  if (ps->mpeg->stream->file)
+    setvbuf(ps->mpeg->stream->file, NULL, _IOFBF, 1 << 20);
+#endif
+  if (rar_seek(ps->mpeg->stream, offset, SEEK_SET)) {
+    mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Can't seek in %s\n", filename);
+    mpeg_free(ps->mpeg);
+    ps->mpeg = NULL;
+    return -1;
+  }
+  ps->mpeg->end = offset + length;
+  return 0;
+}
+
+int vobsub_ps_get_next_packet(void *this, void **data, int *timestamp) {
+  ps_reader_t *ps = this;
+  mpeg_t *mpeg = ps->mpeg;
+  if (mpeg == NULL) return 0;
+  while (!mpeg_eof(mpeg)) {
+    if (mpeg_run(mpeg) < 0) {
+      if (mpeg_eof(mpeg)) break;
+      mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Broken MPEG stream at %" PRIu64
+             "\n", mpeg_tell(mpeg));
+      return -1;
+    }
+    if (mpeg->vobu_valid) {
+      /* A VOBU which does not start where the last one ended begins a new
+       * cell (or VOB ID) with its own time base. Continue the time line
+       * where the last VOBU ended. */
+      if (!ps->have_vobu)
+        ps->pts_offset = -(int64_t)mpeg->vobu_s_ptm;
+      else if (mpeg->vobu_s_ptm != ps->vobu_e_ptm)
+        ps->pts_offset += (int64_t)ps->vobu_e_ptm - mpeg->vobu_s_ptm;
+      ps->vobu_e_ptm = mpeg->vobu_e_ptm;
+      ps->have_vobu = 1;
+      mpeg->vobu_valid = 0;
+    }
+    if (mpeg->packet_size && mpeg->aid == (int)(0x20 + ps->sid)) {
+      int64_t pts;
+      if (mpeg->has_pts) ps->pts = mpeg->pts;
+      pts = ps->pts + ps->pts_offset;
+      *data = mpeg->packet;
+      *timestamp = pts < 0 ? 0 : pts;
+      return mpeg->packet_size;
+    }
+  }
+  return 0;
+}
+
+void vobsub_ps_close(void *this) {
+  ps_reader_t *ps = this;
+  if (ps->mpeg) mpeg_free(ps->mpeg);
+  free(ps);
+}
+
+#ifdef VOBSUB2SRT_BENCH
+/* Entry points for the micro-benchmarks in bench/ */
+#include "bench_hooks.h"
+
+long bench_mpeg_scan(int fd) {
+  mpeg_t *mpg = mpeg_fdopen(fd);
+  long packets = 0;
+  if (mpg == NULL) return -1;
+  while (!mpeg_eof(mpg)) {
+    if (mpeg_run(mpg) < 0) break;
+    if (mpg->packet_size) ++packets;
+  }
+  mpeg_free(mpg);
+  return packets;
+}
+
+long bench_parse_idx(int fd) {
+  vobsub_t *vob = calloc(1, sizeof(vobsub_t));
+  rar_stream_t *stream = rar_fdopen(fd);
+  unsigned char *extradata = NULL;
+  unsigned int extradata_len = 0;
+  long lines = 0;
+  if (vob && stream) {
+    while (vobsub_parse_one_line(vob, stream, &extradata, &extradata_len) >= 0)
+      ++lines;
+  }
+  free(extradata);
+  if (stream) rar_close(stream);
+  if (vob) vobsub_close(vob);
+  return lines;
+}
+#endif
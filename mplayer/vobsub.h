@@ -19,21 +19,44 @@
 #ifndef MPLAYER_VOBSUB_H
 #define MPLAYER_VOBSUB_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern int vobsub_id;
+/// If set, vobsub_open keeps the parsed index in <subname>.v2sidx and uses it
+/// on the next open of the unchanged files.
+extern int vobsub_index_cache;
 
 void *vobsub_open(const char *subname, const char *const ifo, const int force,
                   unsigned int y_threshold, void **spu);
+/// Like vobsub_open, but the .sub data is read from sub_fd (e.g. a pipe or
+/// stdin) by vobsub_get_next_packet as it arrives. Only the .idx is read up
+/// front. The stream is never seeked and sub_fd is closed by vobsub_close.
+void *vobsub_open_stream(const char *subname, const char *const ifo,
+                         int sub_fd, const int force, unsigned int y_threshold,
+                         void **spu);
 void vobsub_reset(void *vob);
 int vobsub_parse_ifo(void *self, const char *const name, unsigned int *palette,
                      unsigned int *width, unsigned int *height, int force,
                      int sid, char *langid);
+/// Like vobsub_parse_ifo for an IFO at offset in the file (e.g. an ISO image).
+int vobsub_parse_ifo_at(void *self, const char *const name, uint64_t offset,
+                        unsigned int *palette, unsigned int *width,
+                        unsigned int *height, int force, int sid,
+                        char *langid);
 int vobsub_get_packet(void *vobhandle, float pts, void **data, int *timestamp);
 int vobsub_get_next_packet(void *vobhandle, void **data, int *timestamp);
 void vobsub_close(void *self);
+/// Bytes of packet data held in memory now and at most, and the number of
+/// packets read into memory
+void vobsub_get_memory(void *vobhandle, uint64_t *bytes, uint64_t *peak,
+                       unsigned long *allocations);
+/// Number of packets of the selected stream (vobsub_id). With
+/// vobsub_open_stream these are the packets listed in the .idx.
+unsigned int vobsub_get_packet_count(void *vobhandle);
 unsigned int vobsub_get_indexes_count(void * /* vobhandle */);
 char *vobsub_get_id(void * /* vobhandle */, unsigned int /* index */);
 
@@ -50,6 +73,17 @@ unsigned int vobsub_rgb_to_yuv(unsigned int rgb);
 int vobsub_set_from_lang(void *vobhandle, unsigned char *lang);
 void vobsub_seek(void *vobhandle, float pts);
 
+/// Reads the SPU packets of subtitle stream sid (0-31) straight from a MPEG
+/// program stream like a DVD VOB. Video and audio packets are skipped.
+void *vobsub_ps_open(unsigned int sid);
+/// Continues with length bytes at offset of the file (e.g. the next VOB).
+/// The time stamps stay continuous across files and cells.
+int vobsub_ps_set_file(void *ps, const char *filename, uint64_t offset,
+                       uint64_t length);
+/// Returns the size of the next SPU packet, 0 at the end and -1 on errors.
+int vobsub_ps_get_next_packet(void *ps, void **data, int *timestamp);
+void vobsub_ps_close(void *ps);
+
 #ifdef __cplusplus
 }
 #endif
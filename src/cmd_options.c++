@@ -112,7 +112,8 @@ bool cmd_options::parse_cmd(int argc, char **argv) const {
   size_t current_unnamed = 0;
   bool parse_options = true;  // set to false after --
   for (int i = 1; i < argc; ++i) {
-    if (parse_options and argv[i][0] == '-') {
+    // a single "-" is an argument (stdin/stdout)
+    if (parse_options and argv[i][0] == '-' and argv[i][1] != '\0') {
       unsigned offset = 1;
       if (argv[i][1] == '-') {
         if (argv[i][2] == '\0') {
@@ -139,9 +140,9 @@ bool cmd_options::parse_cmd(int argc, char **argv) const {
             break;
           }
 
+          // Check if next argv is an option or argument
           if (i + 1 >= argc or
-              argv[i + 1][0] ==
-                  '-') {  // Check if next argv is an option or argument
+              (argv[i + 1][0] == '-' and argv[i + 1][1] != '\0')) {
             cerr << "option " << argv[i] << " is missing an argument" << endl;
             exit = true;
             return false;
@@ -179,7 +180,12 @@ bool cmd_options::parse_cmd(int argc, char **argv) const {
 }
 
 void cmd_options::help(char const *progname) const {
-  cerr << "usage: " << progname << " [options] <subname>\n" << endl;
+  cerr << "usage: " << progname << " [options]";
+  for (std::vector<unnamed>::const_iterator i = pimpl->unnamed_args.begin();
+       i != pimpl->unnamed_args.end(); ++i) {
+    cerr << " <" << i->name << '>';
+  }
+  cerr << "\n" << endl;
   for (std::vector<option>::const_iterator i = pimpl->options.begin();
        i != pimpl->options.end(); ++i) {
     cerr << "\t--" << i->name;
@@ -0,0 +1,168 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "corpus.h++"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+char const file_magic[8] = {'V', '2', 'S', 'C', 'R', 'P', '\0', '\1'};
+// file header: magic, frame width, frame height, language length, followed
+// by the language
+enum { file_header_size = 20 };
+// record header: counter, start_pts, end_pts, position (x, y, width,
+// height), width, height, lines, followed by (width + 7) / 8 bytes per row,
+// most significant bit first and set for ink (0x00)
+enum { record_header_size = 40 };
+// sanity limit for the image size in a record
+enum { max_dimension = 1 << 14 };
+
+void put32(unsigned char *p, unsigned value) { memcpy(p, &value, 4); }
+
+unsigned get32(unsigned char const *p) {
+  unsigned value;
+  memcpy(&value, p, 4);
+  return value;
+}
+}  // namespace
+
+corpus_writer::corpus_writer() : file(NULL) {}
+
+corpus_writer::~corpus_writer() { close(); }
+
+bool corpus_writer::open(string const &filename, string const &language,
+                         unsigned frame_width, unsigned frame_height) {
+  this->filename = filename;
+  file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    cerr << "could not create " << filename << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, 1 << 20);
+  unsigned char header[file_header_size];
+  memcpy(header, file_magic, sizeof(file_magic));
+  put32(header + 8, frame_width);
+  put32(header + 12, frame_height);
+  put32(header + 16, language.size());
+  fwrite(header, 1, sizeof(header), file);
+  fwrite(language.data(), 1, language.size(), file);
+  return true;
+}
+
+void corpus_writer::add(corpus_image_t const &image,
+                        unsigned char const *pixels, unsigned stride) {
+  if (!file) return;
+  unsigned const row_bytes = (image.width + 7) / 8;
+  packed.assign(record_header_size + row_bytes * image.height, 0);
+  unsigned char *p = packed.data();
+  unsigned const fields[record_header_size / 4] = {
+      image.counter,         image.start_pts,       image.end_pts,
+      image.position.x,      image.position.y,      image.position.width,
+      image.position.height, image.width,           image.height,
+      image.lines};
+  for (unsigned i = 0; i < record_header_size / 4; ++i)
+    put32(p + 4 * i, fields[i]);
+  p += record_header_size;
+  for (unsigned y = 0; y < image.height; ++y, p += row_bytes) {
+    unsigned char const *row = pixels + y * stride;
+    for (unsigned x = 0; x < image.width; ++x)
+      if (row[x] == 0) p[x >> 3] |= 0x80 >> (x & 7);
+  }
+  fwrite(packed.data(), 1, packed.size(), file);
+}
+
+bool corpus_writer::close() {
+  if (!file) return true;
+  bool const ok = !ferror(file) and fclose(file) == 0;
+  file = NULL;
+  if (!ok) cerr << "could not write " << filename << '\n';
+  return ok;
+}
+
+corpus_reader::corpus_reader() : file(NULL), width(0), height(0) {}
+
+corpus_reader::~corpus_reader() {
+  if (file) fclose(file);
+}
+
+bool corpus_reader::open(string const &filename) {
+  this->filename = filename;
+  file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    cerr << "could not open " << filename << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, 1 << 20);
+  unsigned char header[file_header_size];
+  if (fread(header, 1, sizeof(header), file) != sizeof(header) or
+      memcmp(header, file_magic, sizeof(file_magic)) != 0 or
+      get32(header + 16) > 64) {
+    cerr << filename << " is not a vobsub2srt corpus\n";
+    return false;
+  }
+  width = get32(header + 8);
+  height = get32(header + 12);
+  lang.resize(get32(header + 16));
+  if (fread(&lang[0], 1, lang.size(), file) != lang.size()) {
+    cerr << filename << " is not a vobsub2srt corpus\n";
+    return false;
+  }
+  return true;
+}
+
+bool corpus_reader::next(corpus_image_t *image) {
+  if (!file) return false;
+  unsigned char header[record_header_size];
+  size_t const n = fread(header, 1, sizeof(header), file);
+  if (n == 0) return false;
+  if (n == sizeof(header)) {
+    image->counter = get32(header);
+    image->start_pts = get32(header + 4);
+    image->end_pts = get32(header + 8);
+    image->position.x = get32(header + 12);
+    image->position.y = get32(header + 16);
+    image->position.width = get32(header + 20);
+    image->position.height = get32(header + 24);
+    image->width = get32(header + 28);
+    image->height = get32(header + 32);
+    image->lines = get32(header + 36);
+    if (image->width <= max_dimension and image->height <= max_dimension) {
+      unsigned const row_bytes = (image->width + 7) / 8;
+      packed.resize(row_bytes * image->height);
+      if (fread(packed.data(), 1, packed.size(), file) == packed.size()) {
+        image->image.resize(image->width * image->height);
+        unsigned char *dst = image->image.data();
+        unsigned char const *src = packed.data();
+        for (unsigned y = 0; y < image->height; ++y, src += row_bytes) {
+          for (unsigned x = 0; x < image->width; ++x)
+            *dst++ = src[x >> 3] & (0x80 >> (x & 7)) ? 0x00 : 0xff;
+        }
+        return true;
+      }
+    }
+  }
+  cerr << "WARNING: " << filename << " ends with a broken record\n";
+  return false;
+}
@@ -0,0 +1,94 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CORPUS_HXX
+#define CORPUS_HXX
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "subtitle_writer.h++"  // cue_position_t
+
+/// A prepared OCR input (dark text on light background, 0x00 or 0xff)
+struct corpus_image_t {
+  unsigned counter, start_pts, end_pts;
+  cue_position_t position;  ///< of the original image in the frame
+  unsigned width, height;   ///< of the prepared (e.g. scaled) image
+  unsigned lines;          ///< text lines, see analyze_lines
+  std::vector<unsigned char> image;  ///< stride == width
+};
+
+/// Writes the images that go to the OCR into a corpus file (--write-corpus).
+/// The images are packed to 1 bit per pixel, which makes the corpus small and
+/// quick to read again. Records are appended in decoding order.
+struct corpus_writer {
+  corpus_writer();
+  ~corpus_writer();
+
+  /// Creates the file. language is the tesseract language of the run.
+  /// Prints an error on failure.
+  bool open(std::string const &filename, std::string const &language,
+            unsigned frame_width, unsigned frame_height);
+  void add(corpus_image_t const &image, unsigned char const *pixels,
+           unsigned stride);
+  /// Returns false if a write failed
+  bool close();
+  bool is_open() const { return file != NULL; }
+
+ private:
+  FILE *file;
+  std::string filename;
+  std::vector<unsigned char> packed;
+
+  // noncopyable
+  corpus_writer(corpus_writer const &);
+  corpus_writer &operator=(corpus_writer const &);
+};
+
+/// Reads a corpus file for --ocr-from-corpus
+struct corpus_reader {
+  corpus_reader();
+  ~corpus_reader();
+
+  /// Prints an error on failure
+  bool open(std::string const &filename);
+  /// Reads the next image (unpacked to 8 bits per pixel). Returns false at
+  /// the end of the corpus.
+  bool next(corpus_image_t *image);
+
+  std::string const &language() const { return lang; }
+  unsigned frame_width() const { return width; }
+  unsigned frame_height() const { return height; }
+
+ private:
+  FILE *file;
+  std::string filename;
+  std::string lang;
+  unsigned width, height;
+  std::vector<unsigned char> packed;
+
+  // noncopyable
+  corpus_reader(corpus_reader const &);
+  corpus_reader &operator=(corpus_reader const &);
+};
+
+#endif
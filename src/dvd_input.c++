@@ -0,0 +1,311 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dvd_input.h++"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "vobsub.h"
+
+using namespace std;
+
+namespace {
+// sector size of DVDs and of the IFO tables
+enum { sector_size = 2048 };
+
+uint32_t rb32(unsigned char const *p) {
+  return uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+uint32_t rl32(unsigned char const *p) {
+  return uint32_t(p[3]) << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+string to_upper(string s) {
+  transform(s.begin(), s.end(), s.begin(), ::toupper);
+  return s;
+}
+
+bool is_directory(string const &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 and S_ISDIR(st.st_mode);
+}
+
+bool read_at(FILE *file, uint64_t offset, void *buf, size_t size) {
+  return fseeko(file, offset, SEEK_SET) == 0 and
+         fread(buf, size, 1, file) == 1;
+}
+
+string vts_name(unsigned vts, unsigned part, char const *ext) {
+  char name[16];
+  snprintf(name, sizeof(name), "VTS_%02u_%u.%s", vts, part, ext);
+  return name;
+}
+}  // namespace
+
+bool is_dvd_input(string const &path) {
+  if (is_directory(path)) return true;
+  string::size_type const dot = path.rfind('.');
+  return dot != string::npos and to_upper(path.substr(dot + 1)) == "ISO";
+}
+
+dvd_input::dvd_input()
+    : vts(0), frame_width(0), frame_height(0), ps(NULL), next_vob(0) {
+  memset(ifo_palette, 0, sizeof(ifo_palette));
+}
+
+dvd_input::~dvd_input() {
+  if (ps) vobsub_ps_close(ps);
+}
+
+bool dvd_input::list_directory(string const &dir) {
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL) {
+    cerr << "Can't open directory " << dir << '\n';
+    return false;
+  }
+  while (dirent const *entry = readdir(d)) {
+    extent_t file;
+    file.name = to_upper(entry->d_name);
+    file.file = dir + '/' + entry->d_name;
+    struct stat st;
+    if (stat(file.file.c_str(), &st) != 0 or !S_ISREG(st.st_mode)) continue;
+    file.offset = 0;
+    file.size = st.st_size;
+    files.push_back(file);
+  }
+  closedir(d);
+  return true;
+}
+
+// Only the ISO 9660 file system is read. DVD images are UDF/ISO 9660 bridge
+// images and the VOBs are never larger than 1 GiB, so this is enough.
+bool dvd_input::list_iso(string const &image) {
+  FILE *file = fopen(image.c_str(), "rb");
+  if (file == NULL) {
+    cerr << "Can't open " << image << '\n';
+    return false;
+  }
+  unsigned char sector[sector_size];
+  uint64_t root = 0, root_size = 0;
+  for (unsigned s = 16; s < 32; ++s) {  // volume descriptors
+    if (!read_at(file, uint64_t(s) * sector_size, sector, sizeof(sector)) or
+        memcmp(sector + 1, "CD001", 5) != 0 or sector[0] == 255)
+      break;
+    if (sector[0] == 1) {  // primary volume descriptor
+      root = uint64_t(rl32(sector + 156 + 2)) * sector_size;
+      root_size = rl32(sector + 156 + 10);
+      break;
+    }
+  }
+  if (root_size == 0) {
+    fclose(file);
+    cerr << image << " has no ISO 9660 file system\n";
+    return false;
+  }
+
+  // Reads the records of a directory. Records do not cross sectors.
+  auto read_directory = [&](uint64_t offset, uint64_t size, bool want_dirs) {
+    vector<extent_t> res;
+    vector<unsigned char> data(size);
+    if (size == 0 or !read_at(file, offset, data.data(), size)) return res;
+    for (size_t i = 0; i < size;) {
+      unsigned char const *rec = &data[i];
+      if (rec[0] == 0) {  // rest of the sector is empty
+        i = (i / sector_size + 1) * sector_size;
+        continue;
+      }
+      if (rec[0] < 34 or i + rec[0] > size or 33 + rec[32] > rec[0]) break;
+      bool const dir = rec[25] & 2;
+      string name(reinterpret_cast<char const *>(rec + 33), rec[32]);
+      name = to_upper(name.substr(0, name.find(';')));
+      if (dir == want_dirs and !name.empty() and name[0] > 1) {
+        extent_t e;
+        e.name = name;
+        e.file = image;
+        e.offset = uint64_t(rl32(rec + 2)) * sector_size;
+        e.size = rl32(rec + 10);
+        res.push_back(e);
+      }
+      i += rec[0];
+    }
+    return res;
+  };
+
+  vector<extent_t> const root_dirs = read_directory(root, root_size, true);
+  for (size_t i = 0; i < root_dirs.size(); ++i) {
+    if (root_dirs[i].name == "VIDEO_TS")
+      files = read_directory(root_dirs[i].offset, root_dirs[i].size, false);
+  }
+  fclose(file);
+  if (files.empty()) {
+    cerr << image << " has no VIDEO_TS directory\n";
+    return false;
+  }
+  return true;
+}
+
+dvd_input::extent_t const *dvd_input::find(string const &name) const {
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (files[i].name == name) return &files[i];
+  }
+  return NULL;
+}
+
+bool dvd_input::parse_ifo(extent_t const &ifo) {
+  // palette and frame size
+  if (vobsub_parse_ifo_at(NULL, ifo.file.c_str(), ifo.offset, ifo_palette,
+                          &frame_width, &frame_height, 1, -1, NULL) < 0)
+    return false;
+
+  // The stream table is in the first sector and the PGCI (for the physical
+  // stream ids) usually right after it, so reading a few sectors is enough.
+  vector<unsigned char> data(min<uint64_t>(ifo.size, 64 * sector_size));
+  FILE *file = fopen(ifo.file.c_str(), "rb");
+  bool const ok = file and read_at(file, ifo.offset, data.data(),
+                                   data.size());
+  if (file) fclose(file);
+  if (!ok or data.size() < sector_size) {
+    cerr << "Can't read " << ifo.file << '\n';
+    return false;
+  }
+
+  // VTS_SPST_ATRT: number of streams and their attributes
+  unsigned const count = min(data[0x254] << 8 | data[0x255], 32);
+  bool const wide = ((data[0x200] >> 2) & 3) == 3;  // 16:9
+  // SPST_CTL of the first PGC maps the streams to physical stream ids
+  unsigned char const *spst_ctl = NULL;
+  uint64_t const pgci = uint64_t(rb32(&data[0xcc])) * sector_size;
+  if (pgci + 0x10 <= data.size()) {
+    uint64_t const pgc = pgci + rb32(&data[pgci + 0x0c]);
+    if (pgc + 0x1c + 4 * 32 <= data.size()) spst_ctl = &data[pgc + 0x1c];
+  }
+  for (unsigned i = 0; i < count; ++i) {
+    unsigned char const *attr = &data[0x256 + 6 * i];
+    dvd_stream_t stream;
+    stream.index = i;
+    stream.id = i;
+    if (spst_ctl and (spst_ctl[4 * i] & 0x80))
+      stream.id = (wide ? spst_ctl[4 * i + 1] : spst_ctl[4 * i]) & 0x1f;
+    if ((attr[0] & 3) == 1 and isalpha(attr[2]) and isalpha(attr[3])) {
+      stream.language += tolower(attr[2]);
+      stream.language += tolower(attr[3]);
+    }
+    spu_streams.push_back(stream);
+  }
+  return true;
+}
+
+bool dvd_input::open(string const &path, unsigned title_set) {
+  if (is_directory(path)) {
+    // either the VIDEO_TS directory itself or the root of the DVD
+    string dir = path;
+    while (dir.size() > 1 and dir[dir.size() - 1] == '/')
+      dir.erase(dir.size() - 1);
+    string::size_type const slash = dir.rfind('/');
+    if (to_upper(dir.substr(slash == string::npos ? 0 : slash + 1)) !=
+        "VIDEO_TS") {
+      if (is_directory(dir + "/VIDEO_TS"))
+        dir += "/VIDEO_TS";
+      else if (is_directory(dir + "/video_ts"))
+        dir += "/video_ts";
+    }
+    if (!list_directory(dir)) return false;
+  } else if (!list_iso(path)) {
+    return false;
+  }
+
+  // The title VOBs are VTS_nn_1.VOB to VTS_nn_9.VOB, VTS_nn_0.VOB is the menu
+  uint64_t largest = 0;
+  for (unsigned n = 1; n <= 99; ++n) {
+    if (title_set and n != title_set) continue;
+    uint64_t size = 0;
+    for (unsigned part = 1; part <= 9; ++part) {
+      extent_t const *vob = find(vts_name(n, part, "VOB"));
+      if (vob) size += vob->size;
+    }
+    if (size > largest) {
+      largest = size;
+      vts = n;
+    }
+  }
+  if (vts == 0) {
+    if (title_set)
+      cerr << "Title set " << title_set << " not found in " << path << '\n';
+    else
+      cerr << "No DVD title sets found in " << path << '\n';
+    return false;
+  }
+  for (unsigned part = 1; part <= 9; ++part) {
+    extent_t const *vob = find(vts_name(vts, part, "VOB"));
+    if (vob) vobs.push_back(vob);
+  }
+
+  extent_t const *ifo = find(vts_name(vts, 0, "IFO"));
+  if (ifo == NULL) ifo = find(vts_name(vts, 0, "BUP"));  // backup copy
+  if (ifo == NULL) {
+    cerr << "No IFO file for title set " << vts << '\n';
+    return false;
+  }
+  if (!parse_ifo(*ifo)) return false;
+  if (spu_streams.empty()) {
+    cerr << "Title set " << vts << " has no subtitles\n";
+    return false;
+  }
+  return true;
+}
+
+bool dvd_input::select(unsigned index) {
+  for (size_t i = 0; i < spu_streams.size(); ++i) {
+    if (spu_streams[i].index != index) continue;
+    if (ps) vobsub_ps_close(ps);
+    ps = vobsub_ps_open(spu_streams[i].id);
+    next_vob = 0;
+    return ps != NULL;
+  }
+  cerr << "No subtitle stream " << index << " in title set " << vts << '\n';
+  return false;
+}
+
+int dvd_input::next_packet(unsigned char **data, unsigned *pts100) {
+  if (ps == NULL) return -1;
+  for (;;) {
+    void *packet;
+    int timestamp;
+    int const size = vobsub_ps_get_next_packet(ps, &packet, &timestamp);
+    if (size > 0) {
+      *data = static_cast<unsigned char *>(packet);
+      *pts100 = timestamp;
+    }
+    if (size != 0) return size;
+    if (next_vob >= vobs.size()) return 0;
+    extent_t const &vob = *vobs[next_vob++];
+    if (vobsub_ps_set_file(ps, vob.file.c_str(), vob.offset, vob.size) < 0)
+      return -1;
+  }
+}
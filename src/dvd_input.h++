@@ -0,0 +1,88 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DVD_INPUT_HXX
+#define DVD_INPUT_HXX
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// A subpicture stream of a DVD title set (from the VTS IFO)
+struct dvd_stream_t {
+  unsigned index;        ///< stream number as listed in the IFO
+  unsigned id;           ///< physical stream id (substream 0x20 + id)
+  std::string language;  ///< ISO 639-1 code, empty if not set
+};
+
+/// True if the path is a directory (the DVD root or VIDEO_TS) or an .iso file
+bool is_dvd_input(std::string const &path);
+
+/// Reads the subtitles of a DVD title set straight from its VOB files, either
+/// in a VIDEO_TS directory or in an ISO 9660 image. Palette, frame size and
+/// the stream list come from the title set IFO.
+struct dvd_input {
+  dvd_input();
+  ~dvd_input();
+
+  /// Opens the title set (1-99) or, if it is 0, the one with the most VOB
+  /// data (usually the main feature). Prints an error on failure.
+  bool open(std::string const &path, unsigned title_set);
+  unsigned title_set() const { return vts; }
+  std::vector<dvd_stream_t> const &streams() const { return spu_streams; }
+  unsigned const *palette() const { return ifo_palette; }
+  unsigned width() const { return frame_width; }
+  unsigned height() const { return frame_height; }
+  /// Selects the stream with the given index
+  bool select(unsigned index);
+  /// Reads the next SPU packet of the selected stream. Returns its size, 0 at
+  /// the end of the title set and -1 on errors. The data is valid until the
+  /// next call.
+  int next_packet(unsigned char **data, unsigned *pts100);
+
+ private:
+  /// A file of the title set, inside the image if it is an ISO
+  struct extent_t {
+    std::string name;  // upper case name, e.g. VTS_01_1.VOB
+    std::string file;  // file to read
+    uint64_t offset, size;
+  };
+
+  bool list_directory(std::string const &dir);
+  bool list_iso(std::string const &image);
+  bool parse_ifo(extent_t const &ifo);
+  extent_t const *find(std::string const &name) const;
+
+  std::vector<extent_t> files;  // of VIDEO_TS
+  std::vector<extent_t const *> vobs;  // title VOBs of the title set
+  unsigned vts;
+  std::vector<dvd_stream_t> spu_streams;
+  unsigned ifo_palette[16];
+  unsigned frame_width, frame_height;
+  void *ps;  // vobsub_ps reader of the selected stream
+  size_t next_vob;
+
+  // noncopyable
+  dvd_input(dvd_input const &);
+  dvd_input &operator=(dvd_input const &);
+};
+
+#endif
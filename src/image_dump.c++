@@ -0,0 +1,423 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "image_dump.h++"
+#include "trace.h++"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace {
+// images waiting for the writer thread before dump() blocks
+enum { queue_size = 64 };
+// 4 GiB of 32 bit TIFF offsets
+unsigned long long const tiff_limit = 0xffffffffULL;
+
+void put16(unsigned char *p, unsigned value) {  // little endian (TIFF)
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+void put32(unsigned char *p, unsigned long value) {
+  put16(p, value & 0xffff);
+  put16(p + 2, value >> 16);
+}
+
+void put32_be(unsigned char *p, unsigned long value) {  // PNG
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+struct crc32_table {
+  crc32_table() {
+    for (unsigned n = 0; n < 256; ++n) {
+      unsigned long c = n;
+      for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+      value[n] = c;
+    }
+  }
+  unsigned long value[256];
+};
+
+unsigned long crc32_update(unsigned long crc, unsigned char const *data,
+                           size_t size) {
+  static crc32_table const table;
+  crc ^= 0xffffffffUL;
+  for (size_t i = 0; i < size; ++i)
+    crc = table.value[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc ^ 0xffffffffUL;
+}
+
+void append_png_chunk(vector<unsigned char> &png, char const *type,
+                      unsigned char const *data, size_t size) {
+  size_t const start = png.size();
+  png.resize(start + 12 + size);
+  unsigned char *p = &png[start];
+  put32_be(p, size);
+  memcpy(p + 4, type, 4);
+  if (size > 0) memcpy(p + 8, data, size);
+  put32_be(p + 8 + size, crc32_update(0, p + 4, size + 4));
+}
+
+// zlib stream of the rows, each with filter type 0
+vector<unsigned char> png_image_data(unsigned char const *image,
+                                     unsigned width, unsigned height) {
+  vector<unsigned char> raw((width + 1) * static_cast<size_t>(height));
+  for (unsigned y = 0; y < height; ++y) {
+    raw[y * (width + 1)] = 0;
+    memcpy(&raw[y * (width + 1) + 1], image + y * width, width);
+  }
+  vector<unsigned char> data;
+#ifdef HAVE_ZLIB
+  uLongf size = compressBound(raw.size());
+  data.resize(size);
+  // the images are mostly two colors, the fastest level does well enough
+  if (compress2(data.data(), &size, raw.data(), raw.size(), 1) == Z_OK) {
+    data.resize(size);
+    return data;
+  }
+  data.clear();
+#endif
+  // uncompressed deflate blocks
+  data.reserve(raw.size() + raw.size() / 65535 * 5 + 11);
+  data.push_back(0x78);
+  data.push_back(0x01);
+  size_t pos = 0;
+  do {
+    size_t const block = min<size_t>(raw.size() - pos, 65535);
+    data.push_back(pos + block == raw.size() ? 1 : 0);
+    data.push_back(block & 0xff);
+    data.push_back(block >> 8);
+    data.push_back(~block & 0xff);
+    data.push_back((~block >> 8) & 0xff);
+    data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + block);
+    pos += block;
+  } while (pos < raw.size());
+  unsigned long a = 1, b = 0;
+  for (size_t i = 0; i < raw.size(); ++i) {
+    a = (a + raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  unsigned char adler[4];
+  put32_be(adler, (b << 16) | a);
+  data.insert(data.end(), adler, adler + 4);
+  return data;
+}
+
+string pgm_header(unsigned width, unsigned height) {
+  return "P5\n" + to_string(width) + ' ' + to_string(height) + " 255\n";
+}
+
+string counter_name(unsigned counter) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "-%04u", counter);
+  return buf;
+}
+}  // namespace
+
+bool parse_image_dump_format(string const &name, image_dump_format_t *format) {
+  if (name == "pgm")
+    *format = DUMP_PGM;
+  else if (name == "png")
+    *format = DUMP_PNG;
+  else if (name == "tiff")
+    *format = DUMP_TIFF;
+  else if (name == "tar")
+    *format = DUMP_TAR;
+  else
+    return false;
+  return true;
+}
+
+image_dumper::image_dumper()
+    : peak_queue(0),
+      format(DUMP_PGM),
+      thread(NULL),
+      stopping(false),
+      failed(false),
+      container(NULL),
+      offset(0),
+      next_ifd(0) {}
+
+image_dumper::~image_dumper() { finish(); }
+
+bool image_dumper::start(string const &name, image_dump_format_t format) {
+  this->name = name;
+  this->format = format;
+  if (format == DUMP_TIFF or format == DUMP_TAR) {
+    string const filename =
+        name + (format == DUMP_TIFF ? "-images.tiff" : "-images.tar");
+    container = fopen(filename.c_str(), "wb");
+    if (!container) {
+      cerr << "could not create " << filename << ": " << strerror(errno)
+           << '\n';
+      return false;
+    }
+    setvbuf(container, NULL, _IOFBF, 1 << 20);
+    if (format == DUMP_TIFF) {
+      // little endian, first page directory right after the header
+      unsigned char const header[8] = {'I', 'I', 42, 0, 8, 0, 0, 0};
+      write_container(header, sizeof(header));
+      next_ifd = 4;
+    }
+  }
+  thread = new std::thread(&image_dumper::run, this);
+  return true;
+}
+
+void image_dumper::dump(unsigned counter, unsigned char const *image,
+                        unsigned width, unsigned height, unsigned stride) {
+  if (thread == NULL) return;
+  vector<unsigned char> buffer;
+  {
+    unique_lock<mutex> lock(mut);
+    while (queue.size() >= queue_size) changed.wait(lock);
+    if (!spare.empty()) {
+      buffer.swap(spare.back());
+      spare.pop_back();
+    }
+  }
+  buffer.resize(static_cast<size_t>(width) * height);
+  for (unsigned y = 0; y < height; ++y)
+    memcpy(&buffer[y * width], image + y * stride, width);
+  {
+    lock_guard<mutex> guard(mut);
+    queue.push_back(job_t());
+    job_t &job = queue.back();
+    job.counter = counter;
+    job.width = width;
+    job.height = height;
+    job.image.swap(buffer);
+    if (queue.size() > peak_queue) peak_queue = queue.size();
+  }
+  changed.notify_all();
+}
+
+void image_dumper::finish() {
+  if (thread == NULL) return;
+  {
+    lock_guard<mutex> guard(mut);
+    stopping = true;
+  }
+  changed.notify_all();
+  thread->join();
+  delete thread;
+  thread = NULL;
+  if (!container) return;
+  if (format == DUMP_TIFF and offset > 8) {
+    // the last page has no successor
+    unsigned char const zero[4] = {0, 0, 0, 0};
+    if (fseek(container, next_ifd, SEEK_SET) == 0)
+      fwrite(zero, 1, sizeof(zero), container);
+  } else if (format == DUMP_TAR) {
+    static unsigned char const end[1024] = {0};
+    write_container(end, sizeof(end));
+  }
+  if (fclose(container) != 0 and !failed)
+    error(name + (format == DUMP_TIFF ? "-images.tiff" : "-images.tar"));
+  container = NULL;
+}
+
+void image_dumper::run() {
+  trace_thread("image dump");
+  unique_lock<mutex> lock(mut);
+  for (;;) {
+    while (queue.empty() and !stopping) changed.wait(lock);
+    if (queue.empty()) break;
+    job_t job = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    changed.notify_all();
+    write(job);
+    lock.lock();
+    if (spare.size() < queue_size) spare.push_back(std::move(job.image));
+  }
+}
+
+void image_dumper::write(job_t const &job) {
+  trace_span span("dump", job.counter);
+  switch (format) {
+    case DUMP_PGM:
+      write_file(job, ".pgm");
+      break;
+    case DUMP_PNG:
+      write_file(job, ".png");
+      break;
+    case DUMP_TIFF:
+      write_tiff_page(job);
+      break;
+    case DUMP_TAR:
+      write_tar_entry(job);
+      break;
+  }
+}
+
+void image_dumper::write_file(job_t const &job, char const *extension) {
+  string const filename = name + counter_name(job.counter) + extension;
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    error(filename);
+    return;
+  }
+  if (format == DUMP_PNG) {
+    vector<unsigned char> png;
+    static unsigned char const signature[8] = {0x89, 'P',  'N',  'G',
+                                               '\r', '\n', 0x1a, '\n'};
+    png.assign(signature, signature + sizeof(signature));
+    unsigned char ihdr[13] = {0};
+    put32_be(ihdr, job.width);
+    put32_be(ihdr + 4, job.height);
+    ihdr[8] = 8;  // bit depth, the rest is 0: grayscale, deflate, no interlace
+    append_png_chunk(png, "IHDR", ihdr, sizeof(ihdr));
+    vector<unsigned char> const data =
+        png_image_data(job.image.data(), job.width, job.height);
+    append_png_chunk(png, "IDAT", data.data(), data.size());
+    append_png_chunk(png, "IEND", NULL, 0);
+    fwrite(png.data(), 1, png.size(), file);
+  } else {
+    string const header = pgm_header(job.width, job.height);
+    fwrite(header.data(), 1, header.size(), file);
+    fwrite(job.image.data(), 1, job.image.size(), file);
+  }
+  if (fclose(file) != 0) error(filename);
+}
+
+// Every page is a directory followed by its description, resolution and the
+// uncompressed 8 bit gray image. The directory already points to where the
+// next page will go, finish() clears that pointer of the last page.
+void image_dumper::write_tiff_page(job_t const &job) {
+  enum { entries = 14, ifd_size = 2 + entries * 12 + 4 };
+  string const description = "vobsub2srt subtitle " + to_string(job.counter);
+  unsigned long const description_offset = offset + ifd_size;
+  unsigned long const resolution_offset =
+      description_offset + ((description.size() + 2) & ~1UL);
+  unsigned long const data_offset = resolution_offset + 16;
+  unsigned long long const end =
+      data_offset + ((job.image.size() + 1) & ~static_cast<size_t>(1));
+  if (end > tiff_limit) {
+    if (!failed)
+      cerr << "WARNING: " << name << "-images.tiff is full (4 GiB), no more "
+           << "images are dumped\n";
+    failed = true;
+    return;
+  }
+
+  vector<unsigned char> page(data_offset - offset);
+  unsigned char *p = page.data();
+  put16(p, entries);
+  p += 2;
+  struct {
+    unsigned tag, type;  // type 2: ASCII, 3: SHORT, 4: LONG, 5: RATIONAL
+    unsigned long count, value;
+  } const ifd[entries] = {
+      {254, 4, 1, 2},  // NewSubfileType: page of a multi-page image
+      {256, 4, 1, job.width},
+      {257, 4, 1, job.height},
+      {258, 3, 1, 8},  // BitsPerSample
+      {259, 3, 1, 1},  // Compression: none
+      {262, 3, 1, 1},  // PhotometricInterpretation: black is zero
+      {270, 2, description.size() + 1, description_offset},
+      {273, 4, 1, data_offset},  // StripOffsets
+      {277, 3, 1, 1},            // SamplesPerPixel
+      {278, 4, 1, job.height},   // RowsPerStrip
+      {279, 4, 1, job.image.size()},
+      {282, 5, 1, resolution_offset},      // XResolution
+      {283, 5, 1, resolution_offset + 8},  // YResolution
+      {296, 3, 1, 2}                       // ResolutionUnit: inch
+  };
+  for (unsigned i = 0; i < entries; ++i, p += 12) {
+    put16(p, ifd[i].tag);
+    put16(p + 2, ifd[i].type);
+    put32(p + 4, ifd[i].count);
+    if (ifd[i].type == 3)
+      put16(p + 8, ifd[i].value);
+    else
+      put32(p + 8, ifd[i].value);
+  }
+  put32(p, end);  // the next page
+  next_ifd = offset + ifd_size - 4;
+  memcpy(&page[description_offset - offset], description.c_str(),
+         description.size() + 1);
+  for (unsigned i = 0; i < 2; ++i) {  // 72 dpi
+    put32(&page[resolution_offset - offset + 8 * i], 72);
+    put32(&page[resolution_offset - offset + 8 * i + 4], 1);
+  }
+  write_container(page.data(), page.size());
+  write_container(job.image.data(), job.image.size());
+  if (offset & 1) write_container("", 1);
+}
+
+void image_dumper::write_tar_entry(job_t const &job) {
+  string::size_type const slash = name.rfind('/');
+  string base = name.substr(slash == string::npos ? 0 : slash + 1);
+  string const suffix = counter_name(job.counter) + ".pgm";
+  if (base.size() + suffix.size() > 99) base.resize(99 - suffix.size());
+  string const pgm = pgm_header(job.width, job.height);
+  size_t const size = pgm.size() + job.image.size();
+
+  // ustar header
+  unsigned char header[512] = {0};
+  memcpy(header, (base + suffix).c_str(), base.size() + suffix.size());
+  snprintf(reinterpret_cast<char *>(header + 100), 8, "%07o", 0644);
+  snprintf(reinterpret_cast<char *>(header + 108), 8, "%07o", 0);
+  snprintf(reinterpret_cast<char *>(header + 116), 8, "%07o", 0);
+  snprintf(reinterpret_cast<char *>(header + 124), 12, "%011llo",
+           static_cast<unsigned long long>(size));
+  snprintf(reinterpret_cast<char *>(header + 136), 12, "%011llo",
+           static_cast<unsigned long long>(time(NULL)));
+  header[156] = '0';  // regular file
+  memcpy(header + 257, "ustar\0" "00", 8);
+  memset(header + 148, ' ', 8);
+  unsigned checksum = 0;
+  for (unsigned i = 0; i < sizeof(header); ++i) checksum += header[i];
+  snprintf(reinterpret_cast<char *>(header + 148), 8, "%06o", checksum);
+
+  write_container(header, sizeof(header));
+  write_container(pgm.data(), pgm.size());
+  write_container(job.image.data(), job.image.size());
+  static unsigned char const padding[512] = {0};
+  if (size % 512) write_container(padding, 512 - size % 512);
+}
+
+void image_dumper::write_container(void const *data, size_t size) {
+  if (fwrite(data, 1, size, container) != size and !failed)
+    error(name + (format == DUMP_TIFF ? "-images.tiff" : "-images.tar"));
+  offset += size;
+}
+
+void image_dumper::error(string const &filename) {
+  if (failed) return;
+  // once is enough, the other images most likely fail the same way
+  cerr << "WARNING: could not write " << filename << ": " << strerror(errno)
+       << '\n';
+  failed = true;
+}
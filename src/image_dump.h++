@@ -0,0 +1,96 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef IMAGE_DUMP_HXX
+#define IMAGE_DUMP_HXX
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Formats of --dump-format
+enum image_dump_format_t {
+  DUMP_PGM,   ///< <name>-<number>.pgm per image
+  DUMP_PNG,   ///< <name>-<number>.png per image
+  DUMP_TIFF,  ///< all images as pages of <name>-images.tiff
+  DUMP_TAR    ///< all images as PGM files in <name>-images.tar
+};
+
+/// Parses a --dump-format name ("pgm", "png", "tiff" or "tar")
+bool parse_image_dump_format(std::string const &name,
+                             image_dump_format_t *format);
+
+/// Writes the subtitle images in a background thread. dump() only copies the
+/// image into a bounded queue, so the decoding isn't slowed down by the file
+/// system. It blocks if the writer falls too far behind.
+struct image_dumper {
+  image_dumper();
+  ~image_dumper();
+
+  /// Starts the writer thread. name is the output name without extension.
+  /// Prints an error if the TIFF or tar file can't be created.
+  bool start(std::string const &name, image_dump_format_t format);
+  /// Queues a copy of the image
+  void dump(unsigned counter, unsigned char const *image, unsigned width,
+            unsigned height, unsigned stride);
+  /// Writes the remaining images and stops the thread
+  void finish();
+
+  size_t peak_queue;  ///< most images waiting to be written at a time
+
+ private:
+  struct job_t {
+    unsigned counter, width, height;
+    std::vector<unsigned char> image;  // packed, stride == width
+  };
+
+  void run();
+  void write(job_t const &job);
+  void write_file(job_t const &job, char const *extension);
+  void write_tiff_page(job_t const &job);
+  void write_tar_entry(job_t const &job);
+  void write_container(void const *data, size_t size);
+  void error(std::string const &filename);
+
+  std::string name;
+  image_dump_format_t format;
+  std::thread *thread;
+  std::mutex mut;
+  std::condition_variable changed;
+  std::deque<job_t> queue;
+  std::vector<std::vector<unsigned char>> spare;  // image buffers to reuse
+  bool stopping;
+  bool failed;  // an error has been reported
+
+  FILE *container;         // the .tiff or .tar file
+  unsigned long offset;    // write position in the container
+  unsigned long next_ifd;  // TIFF: where to put the offset of the next page
+
+  // noncopyable
+  image_dumper(image_dumper const &);
+  image_dumper &operator=(image_dumper const &);
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "image_prep.h++"
+#include "memory.h++"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+line_stats_t analyze_lines(unsigned char const *image, unsigned width,
+                           unsigned height, unsigned stride) {
+  line_stats_t res = {0, 0};
+  unsigned line_start = 0;
+  bool in_line = false;
+  for (unsigned y = 0; y <= height; ++y) {
+    // memchr is the quickest way to find a single ink pixel in a row
+    bool const ink = y < height and memchr(image + y * stride, 0, width);
+    if (ink and not in_line) {
+      line_start = y;
+      in_line = true;
+    } else if (not ink and in_line) {
+      ++res.lines;
+      if (y - line_start > res.max_height) res.max_height = y - line_start;
+      in_line = false;
+    }
+  }
+  return res;
+}
+
+unsigned count_ink(unsigned char const *image, unsigned width, unsigned height,
+                   unsigned stride) {
+  unsigned ink = 0;
+  for (unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = image + y * stride;
+    for (unsigned x = 0; x < width; ++x) ink += row[x] == 0;
+  }
+  return ink;
+}
+
+void invert_image(unsigned char const *src, size_t image_size,
+                  unsigned char *dst) {
+  for (size_t i = 0; i < image_size; ++i)
+    dst[i] = ((255 - src[i]) > 0x80) ? 0xff : 0;
+}
+
+unsigned long long estimate_ocr_cost(unsigned width, unsigned height,
+                                     unsigned lines) {
+  // Each line costs roughly a strip of its width again (segmentation,
+  // classifier and dictionary passes), so weigh it in on top of the area.
+  enum { line_weight = 16 };
+  return static_cast<unsigned long long>(width) * height +
+         static_cast<unsigned long long>(width) * lines * line_weight;
+}
+
+void downscale_half(unsigned char const *src, unsigned width, unsigned height,
+                    unsigned stride, unsigned char *dst) {
+  unsigned const dst_width = width / 2, dst_height = height / 2;
+  for (unsigned y = 0; y < dst_height; ++y) {
+    unsigned char const *row0 = src + 2 * y * stride;
+    unsigned char const *row1 = row0 + stride;
+    for (unsigned x = 0; x < dst_width; ++x) {
+      *dst++ = (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] +
+                row1[2 * x + 1] + 2) >> 2;
+    }
+  }
+}
+
+double text_scale_factor(line_stats_t const &lines, unsigned target_height) {
+  if (lines.max_height == 0 or target_height == 0) return 1.0;
+  double factor = static_cast<double>(target_height) / lines.max_height;
+  // Resampling costs time and softens the glyphs, only do it if it matters.
+  if (std::fabs(factor - 1.0) < 0.1) return 1.0;
+  if (factor > 4.0) factor = 4.0;
+  if (factor < 0.25) factor = 0.25;
+  return factor;
+}
+
+namespace {
+// The tables below are kept per thread and only grow, which spares the
+// allocations once the largest image has been scaled.
+void reserve_table(std::vector<unsigned> &table, size_t size) {
+  if (size <= table.capacity()) {
+    table.resize(size);
+  } else {
+    buffer_growth growing;
+    table.resize(size);
+  }
+}
+
+// 24.8 fixed point source position of every destination pixel for bilinear
+// enlarging, sampling at the pixel centers
+void bilinear_table(unsigned src_len, unsigned dst_len,
+                    std::vector<unsigned> &pos, std::vector<unsigned> &frac) {
+  reserve_table(pos, dst_len);
+  reserve_table(frac, dst_len);
+  for (unsigned i = 0; i < dst_len; ++i) {
+    long long p = ((2LL * i + 1) * src_len * 256) / (2LL * dst_len) - 128;
+    if (p < 0) p = 0;
+    if (p > (src_len - 1) * 256LL) p = (src_len - 1) * 256LL;
+    pos[i] = static_cast<unsigned>(p >> 8);
+    frac[i] = static_cast<unsigned>(p & 0xff);
+  }
+}
+
+void scale_up(unsigned char const *src, unsigned width, unsigned height,
+              unsigned stride, unsigned char *dst, unsigned dst_width,
+              unsigned dst_height) {
+  static thread_local std::vector<unsigned> xpos, xfrac, ypos, yfrac;
+  bilinear_table(width, dst_width, xpos, xfrac);
+  bilinear_table(height, dst_height, ypos, yfrac);
+  for (unsigned y = 0; y < dst_height; ++y) {
+    unsigned char const *row0 = src + ypos[y] * stride;
+    unsigned char const *row1 = ypos[y] + 1 < height ? row0 + stride : row0;
+    unsigned const fy = yfrac[y];
+    for (unsigned x = 0; x < dst_width; ++x) {
+      unsigned const x0 = xpos[x];
+      unsigned const x1 = x0 + 1 < width ? x0 + 1 : x0;
+      unsigned const fx = xfrac[x];
+      unsigned const top = row0[x0] * (256 - fx) + row0[x1] * fx;
+      unsigned const bottom = row1[x0] * (256 - fx) + row1[x1] * fx;
+      *dst++ = (top * (256 - fy) + bottom * fy + 32768) >> 16;
+    }
+  }
+}
+
+void scale_down(unsigned char const *src, unsigned width, unsigned height,
+                unsigned stride, unsigned char *dst, unsigned dst_width,
+                unsigned dst_height) {
+  static thread_local std::vector<unsigned> xstart;
+  reserve_table(xstart, dst_width + 1);
+  for (unsigned x = 0; x <= dst_width; ++x)
+    xstart[x] = static_cast<unsigned long long>(x) * width / dst_width;
+  for (unsigned y = 0; y < dst_height; ++y) {
+    unsigned const y0 =
+        static_cast<unsigned long long>(y) * height / dst_height;
+    unsigned y1 =
+        static_cast<unsigned long long>(y + 1) * height / dst_height;
+    if (y1 <= y0) y1 = y0 + 1;
+    for (unsigned x = 0; x < dst_width; ++x) {
+      unsigned const x0 = xstart[x];
+      unsigned const x1 = xstart[x + 1] > x0 ? xstart[x + 1] : x0 + 1;
+      unsigned sum = 0;
+      for (unsigned sy = y0; sy < y1; ++sy) {
+        unsigned char const *row = src + sy * stride;
+        for (unsigned sx = x0; sx < x1; ++sx) sum += row[sx];
+      }
+      unsigned const count = (y1 - y0) * (x1 - x0);
+      *dst++ = (sum + count / 2) / count;
+    }
+  }
+}
+}  // namespace
+
+void scale_image(unsigned char const *src, unsigned width, unsigned height,
+                 unsigned stride, unsigned char *dst, unsigned dst_width,
+                 unsigned dst_height) {
+  if (dst_width >= width and dst_height >= height)
+    scale_up(src, width, height, stride, dst, dst_width, dst_height);
+  else
+    scale_down(src, width, height, stride, dst, dst_width, dst_height);
+}
+
+void threshold_image(unsigned char *image, size_t image_size) {
+  for (size_t i = 0; i < image_size; ++i)
+    image[i] = image[i] >= 0x80 ? 0xff : 0;
+}
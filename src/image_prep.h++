@@ -0,0 +1,69 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_PREP_HXX
+#define IMAGE_PREP_HXX
+
+#include <cstddef>
+
+/// Text lines found in a prepared (dark text on light background) image
+struct line_stats_t {
+  unsigned lines;       ///< number of text lines
+  unsigned max_height;  ///< height of the tallest line in pixels
+};
+
+/// Groups the rows containing ink (0x00 pixels) into text lines
+line_stats_t analyze_lines(unsigned char const *image, unsigned width,
+                           unsigned height, unsigned stride);
+
+/// Turns the light text on dark background of a subtitle into black (0x00)
+/// text on white (0xff), which suits tesseract 4 and later best. dst may be
+/// src.
+void invert_image(unsigned char const *src, size_t image_size,
+                  unsigned char *dst);
+
+/// Number of ink (0x00) pixels
+unsigned count_ink(unsigned char const *image, unsigned width, unsigned height,
+                   unsigned stride);
+
+/// Estimates the relative OCR cost of an image. Tesseract scales with the
+/// number of pixels it has to look at and does a recognition pass per line.
+unsigned long long estimate_ocr_cost(unsigned width, unsigned height,
+                                     unsigned lines);
+
+/// Halves width and height by averaging 2x2 blocks. dst must hold
+/// (width / 2) * (height / 2) bytes and gets a stride of width / 2.
+void downscale_half(unsigned char const *src, unsigned width, unsigned height,
+                    unsigned stride, unsigned char *dst);
+
+/// Factor that resamples the tallest text line to target_height pixels.
+/// Returns 1.0 if the image is already close enough to the target.
+double text_scale_factor(line_stats_t const &lines, unsigned target_height);
+
+/// Resamples the image to dst_width x dst_height with a stride of dst_width.
+/// Enlarging is bilinear, shrinking averages the covered source pixels.
+void scale_image(unsigned char const *src, unsigned width, unsigned height,
+                 unsigned stride, unsigned char *dst, unsigned dst_width,
+                 unsigned dst_height);
+
+/// Maps every pixel to 0x00 or 0xff again (e.g. after scaling)
+void threshold_image(unsigned char *image, size_t image_size);
+
+#endif
@@ -68,6 +68,17 @@ static char const *const iso639_3[] = {
 // static char const *const *const iso639_3_end = iso639_3 +
 // sizeof(iso639_3)/sizeof(iso639_3[0]);
 
+// ISO 639-2/B codes that differ from ISO 639-2/T (and thus ISO 639-3)
+static char const *const iso639_2b[] = {
+    "alb", "arm", "baq", "bur", "chi", "cze", "dut", "fre", "geo", "ger",
+    "gre", "ice", "mac", "mao", "may", "per", "rum", "slo", "tib", "wel"};
+static char const *const *const iso639_2b_end =
+    iso639_2b + sizeof(iso639_2b) / sizeof(iso639_2b[0]);
+
+static char const *const iso639_2t[] = {
+    "sqi", "hye", "eus", "mya", "zho", "ces", "nld", "fra", "kat", "deu",
+    "ell", "isl", "mkd", "mri", "msa", "fas", "ron", "slk", "bod", "cym"};
+
 static bool compare(char const *lhs, char const *rhs) {
   return std::strcmp(lhs, rhs) < 0;
 }
@@ -84,3 +95,13 @@ char const *iso639_1_to_639_3(char const *lang) {
     return iso639_3[i - iso639_1];
   }
 }
+
+char const *iso639_2b_to_639_3(char const *lang) {
+  assert(sizeof(iso639_2b) == sizeof(iso639_2t));
+  char const *const *i =
+      std::lower_bound(iso639_2b, iso639_2b_end, lang, compare);
+  if (i != iso639_2b_end and std::strcmp(*i, lang) == 0) {
+    return iso639_2t[i - iso639_2b];
+  }
+  return lang;
+}
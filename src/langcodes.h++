@@ -25,4 +25,8 @@
 /// (three letter)
 char const *iso639_1_to_639_3(char const *lang);
 
+/// Converts ISO 639-2/B language code (bibliographic, e.g. ger as used by
+/// Matroska) to ISO 639-3. Other three letter codes are returned unchanged.
+char const *iso639_2b_to_639_3(char const *lang);
+
 #endif
@@ -0,0 +1,703 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "matroska.h++"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+// EBML and Matroska element IDs (including the length marker bits)
+enum : uint32_t {
+  ID_EBML = 0x1A45DFA3,
+  ID_DOCTYPE = 0x4282,
+  ID_SEGMENT = 0x18538067,
+  ID_SEEKHEAD = 0x114D9B74,
+  ID_SEEK = 0x4DBB,
+  ID_SEEKID = 0x53AB,
+  ID_SEEKPOSITION = 0x53AC,
+  ID_INFO = 0x1549A966,
+  ID_TIMECODESCALE = 0x2AD7B1,
+  ID_TRACKS = 0x1654AE6B,
+  ID_TRACKENTRY = 0xAE,
+  ID_TRACKNUMBER = 0xD7,
+  ID_CODECID = 0x86,
+  ID_CODECPRIVATE = 0x63A2,
+  ID_LANGUAGE = 0x22B59C,
+  ID_LANGUAGEIETF = 0x22B59D,
+  ID_NAME = 0x536E,
+  ID_CONTENTENCODINGS = 0x6D80,
+  ID_CONTENTENCODING = 0x6240,
+  ID_CONTENTENCODINGSCOPE = 0x5032,
+  ID_CONTENTCOMPRESSION = 0x5034,
+  ID_CONTENTCOMPALGO = 0x4254,
+  ID_CONTENTCOMPSETTINGS = 0x4255,
+  ID_CONTENTENCRYPTION = 0x5035,
+  ID_CLUSTER = 0x1F43B675,
+  ID_TIMECODE = 0xE7,
+  ID_BLOCKGROUP = 0xA0,
+  ID_BLOCK = 0xA1,
+  ID_SIMPLEBLOCK = 0xA3,
+  ID_CUES = 0x1C53BB6B,
+  ID_CUEPOINT = 0xBB,
+  ID_CUETRACKPOSITIONS = 0xB7,
+  ID_CUETRACK = 0xF7,
+  ID_CUECLUSTERPOSITION = 0xF1,
+  ID_CUERELATIVEPOSITION = 0xF0
+};
+
+uint64_t const unknown_size = ~0ULL;
+// No sane CodecPrivate or subtitle block gets anywhere near this
+uint64_t const max_data_size = 64 << 20;
+
+enum { COMPRESSION_NONE = -1, COMPRESSION_ZLIB = 0, COMPRESSION_STRIP = 3 };
+enum { COMPRESSION_ENCRYPTED = -2 };
+}  // namespace
+
+bool is_matroska_file(std::string const &filename) {
+  std::string::size_type const dot = filename.rfind('.');
+  if (dot == std::string::npos) return false;
+  std::string ext = filename.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == "mkv" or ext == "mks" or ext == "webm";
+}
+
+matroska_reader::matroska_reader()
+    : file(NULL),
+      pos(0),
+      segment_start(0),
+      segment_end(unknown_size),
+      first_cluster(unknown_size),
+      seek_info(unknown_size),
+      seek_tracks(unknown_size),
+      seek_cues(unknown_size),
+      have_info(false),
+      have_tracks(false),
+      timecode_scale(1000000),
+      selected(NULL),
+      next_cue(0),
+      use_cues(false),
+      scan_end(0),
+      scan_one_cluster(false),
+      cluster(unknown_size),
+      cluster_data(0),
+      cluster_end(0),
+      cluster_timecode(0) {}
+
+matroska_reader::~matroska_reader() {
+  if (file) fclose(file);
+}
+
+bool matroska_reader::read(void *buf, size_t size) {
+  if (fread(buf, 1, size, file) != size) return false;
+  pos += size;
+  return true;
+}
+
+bool matroska_reader::seek(uint64_t to) {
+  if (to == pos) return true;
+  if (to > static_cast<uint64_t>(LLONG_MAX) or
+      fseeko(file, static_cast<off_t>(to), SEEK_SET) != 0)
+    return false;
+  pos = to;
+  return true;
+}
+
+bool matroska_reader::skip(uint64_t size) { return seek(pos + size); }
+
+bool matroska_reader::read_header(uint32_t *id, uint64_t *size) {
+  unsigned char b[8];
+  // the ID keeps its length marker, IDs are at most 4 bytes long
+  if (!read(b, 1)) return false;
+  unsigned len = 1;
+  while (len <= 4 and !(b[0] & (0x100 >> len))) ++len;
+  if (len > 4 or (len > 1 and !read(b + 1, len - 1))) return false;
+  *id = 0;
+  for (unsigned i = 0; i < len; ++i) *id = *id << 8 | b[i];
+
+  if (!read(b, 1)) return false;
+  len = 1;
+  while (len <= 8 and !(b[0] & (0x100 >> len))) ++len;
+  if (len > 8 or (len > 1 and !read(b + 1, len - 1))) return false;
+  uint64_t value = b[0] & (0xff >> len);
+  for (unsigned i = 1; i < len; ++i) value = value << 8 | b[i];
+  // all value bits set means the size is unknown (live streams)
+  *size = value == (1ULL << (7 * len)) - 1 ? unknown_size : value;
+  return true;
+}
+
+uint64_t matroska_reader::read_uint(uint64_t size) {
+  unsigned char b[8];
+  if (size > sizeof(b)) {
+    skip(size);
+    return 0;
+  }
+  if (!read(b, size)) return 0;
+  uint64_t value = 0;
+  for (unsigned i = 0; i < size; ++i) value = value << 8 | b[i];
+  return value;
+}
+
+bool matroska_reader::read_data(uint64_t size,
+                                std::vector<unsigned char> &data) {
+  if (size > max_data_size) {
+    std::cerr << "Matroska: element of " << size << " bytes in '" << filename
+              << "' is too large\n";
+    return false;
+  }
+  data.resize(size);
+  return size == 0 or read(data.data(), size);
+}
+
+bool matroska_reader::read_string(uint64_t size, std::string &str) {
+  std::vector<unsigned char> data;
+  if (!read_data(size, data)) return false;
+  // strings may be zero padded
+  str.assign(data.begin(), std::find(data.begin(), data.end(), 0));
+  return true;
+}
+
+bool matroska_reader::open(std::string const &filename) {
+  this->filename = filename;
+  file = fopen(filename.c_str(), "rb");
+  if (file == NULL) {
+    std::cerr << "Couldn't open Matroska file '" << filename << "'\n";
+    return false;
+  }
+  // The subtitle blocks are small and spread out, skipping the video in
+  // between mostly happens within the buffer.
+  setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+  uint32_t id;
+  uint64_t size;
+  std::string doctype = "matroska";
+  if (!read_header(&id, &size) or id != ID_EBML or size == unknown_size) {
+    std::cerr << "'" << filename << "' is not a Matroska file\n";
+    return false;
+  }
+  uint64_t const header_end = pos + size;
+  while (pos < header_end and read_header(&id, &size)) {
+    if (id == ID_DOCTYPE) {
+      if (!read_string(size, doctype)) break;
+    } else if (size == unknown_size or !skip(size)) {
+      break;
+    }
+  }
+  if (doctype != "matroska" and doctype != "webm") {
+    std::cerr << "'" << filename << "' has unsupported DocType '" << doctype
+              << "'\n";
+    return false;
+  }
+  if (!seek(header_end) or !read_header(&id, &size) or id != ID_SEGMENT) {
+    std::cerr << "Matroska: no segment in '" << filename << "'\n";
+    return false;
+  }
+  segment_start = pos;
+  segment_end = size == unknown_size ? unknown_size : pos + size;
+
+  // Everything but the clusters (and usually the cues) comes first
+  for (;;) {
+    uint64_t const start = pos;
+    if (pos >= segment_end or !read_header(&id, &size)) break;
+    if (id == ID_CLUSTER) {
+      first_cluster = start;
+      break;
+    }
+    if (size == unknown_size) {
+      std::cerr << "Matroska: element " << std::hex << id << std::dec
+                << " of unknown size in '" << filename << "'\n";
+      return false;
+    }
+    uint64_t const end = pos + size;
+    bool ok = true;
+    switch (id) {
+      case ID_SEEKHEAD:
+        ok = parse_seek_head(end);
+        break;
+      case ID_INFO:
+        ok = parse_info(end);
+        break;
+      case ID_TRACKS:
+        ok = parse_tracks(end);
+        break;
+      case ID_CUES:
+        seek_cues = start - segment_start;
+        break;
+    }
+    if (!ok or !seek(end)) {
+      std::cerr << "Matroska: error reading '" << filename << "'\n";
+      return false;
+    }
+  }
+  if (first_cluster == unknown_size) first_cluster = pos;
+
+  // Info and Tracks may also be behind the clusters
+  if (!have_info and seek_info != unknown_size and
+      seek(segment_start + seek_info) and read_header(&id, &size) and
+      id == ID_INFO and size != unknown_size) {
+    parse_info(pos + size);
+  }
+  if (!have_tracks and seek_tracks != unknown_size and
+      seek(segment_start + seek_tracks) and read_header(&id, &size) and
+      id == ID_TRACKS and size != unknown_size) {
+    parse_tracks(pos + size);
+  }
+  if (vobsub_tracks.empty()) {
+    std::cerr << "No VobSub tracks in '" << filename << "'\n";
+    return false;
+  }
+  return true;
+}
+
+bool matroska_reader::parse_seek_head(uint64_t end) {
+  uint32_t id;
+  uint64_t size;
+  while (pos < end and read_header(&id, &size)) {
+    if (id != ID_SEEK) {
+      if (!skip(size)) return false;
+      continue;
+    }
+    uint64_t const seek_end = pos + size;
+    uint64_t seek_id = 0, seek_position = unknown_size;
+    while (pos < seek_end and read_header(&id, &size)) {
+      if (id == ID_SEEKID)
+        seek_id = read_uint(size);
+      else if (id == ID_SEEKPOSITION)
+        seek_position = read_uint(size);
+      else if (!skip(size))
+        return false;
+    }
+    if (seek_id == ID_INFO)
+      seek_info = seek_position;
+    else if (seek_id == ID_TRACKS)
+      seek_tracks = seek_position;
+    else if (seek_id == ID_CUES)
+      seek_cues = seek_position;
+  }
+  return pos == end;
+}
+
+bool matroska_reader::parse_info(uint64_t end) {
+  uint32_t id;
+  uint64_t size;
+  while (pos < end and read_header(&id, &size)) {
+    if (id == ID_TIMECODESCALE)
+      timecode_scale = read_uint(size);
+    else if (!skip(size))
+      return false;
+  }
+  if (timecode_scale == 0) timecode_scale = 1000000;
+  have_info = true;
+  return pos == end;
+}
+
+bool matroska_reader::parse_tracks(uint64_t end) {
+  uint32_t id;
+  uint64_t size;
+  unsigned index = 0;
+  while (pos < end and read_header(&id, &size)) {
+    if (id == ID_TRACKENTRY) {
+      vobsub_tracks.push_back(mkv_track_t());
+      vobsub_tracks.back().id = index++;
+      if (!parse_track_entry(pos + size)) return false;
+    } else if (!skip(size)) {
+      return false;
+    }
+  }
+  have_tracks = true;
+  return pos == end;
+}
+
+bool matroska_reader::parse_track_entry(uint64_t end) {
+  mkv_track_t &track = vobsub_tracks.back();
+  track.number = 0;
+  track.language = "eng";  // the Matroska default
+  track.compression = COMPRESSION_NONE;
+  std::string codec_id, language_ietf;
+  int scope = 1;
+  uint32_t id;
+  uint64_t size;
+  bool ok = true;
+  while (ok and pos < end and read_header(&id, &size)) {
+    switch (id) {
+      case ID_TRACKNUMBER:
+        track.number = read_uint(size);
+        break;
+      case ID_CODECID:
+        ok = read_string(size, codec_id);
+        break;
+      case ID_CODECPRIVATE:
+        ok = read_data(size, track.codec_private);
+        break;
+      case ID_LANGUAGE:
+        ok = read_string(size, track.language);
+        break;
+      case ID_LANGUAGEIETF:
+        ok = read_string(size, language_ietf);
+        break;
+      case ID_NAME:
+        ok = read_string(size, track.name);
+        break;
+      case ID_CONTENTENCODINGS:
+        ok = parse_content_encodings(pos + size, track, &scope);
+        break;
+      default:
+        ok = skip(size);
+    }
+  }
+  if (codec_id != "S_VOBSUB") {
+    vobsub_tracks.pop_back();
+    return ok;
+  }
+  if (!language_ietf.empty()) track.language = language_ietf;
+  // scope 2: the CodecPrivate is compressed as well
+  if (scope & 2 and track.compression != COMPRESSION_NONE) {
+    std::vector<unsigned char> codec_private;
+    if (decode(track, track.codec_private, codec_private))
+      track.codec_private.swap(codec_private);
+  }
+  return ok and pos == end;
+}
+
+bool matroska_reader::parse_content_encodings(uint64_t end, mkv_track_t &track,
+                                              int *scope) {
+  uint32_t id;
+  uint64_t size;
+  while (pos < end and read_header(&id, &size)) {
+    if (id != ID_CONTENTENCODING) {
+      if (!skip(size)) return false;
+      continue;
+    }
+    uint64_t const encoding_end = pos + size;
+    while (pos < encoding_end and read_header(&id, &size)) {
+      if (id == ID_CONTENTENCODINGSCOPE) {
+        *scope = read_uint(size);
+      } else if (id == ID_CONTENTENCRYPTION) {
+        track.compression = COMPRESSION_ENCRYPTED;
+        if (!skip(size)) return false;
+      } else if (id == ID_CONTENTCOMPRESSION) {
+        uint64_t const compression_end = pos + size;
+        if (track.compression != COMPRESSION_ENCRYPTED)
+          track.compression = COMPRESSION_ZLIB;  // the default algorithm
+        while (pos < compression_end and read_header(&id, &size)) {
+          if (id == ID_CONTENTCOMPALGO) {
+            int const algo = read_uint(size);
+            if (track.compression != COMPRESSION_ENCRYPTED)
+              track.compression = algo;
+          } else if (id == ID_CONTENTCOMPSETTINGS) {
+            if (!read_data(size, track.stripped_header)) return false;
+          } else if (!skip(size)) {
+            return false;
+          }
+        }
+      } else if (!skip(size)) {
+        return false;
+      }
+    }
+  }
+  return pos == end;
+}
+
+bool matroska_reader::parse_cues(uint64_t end, unsigned track_number) {
+  uint32_t id;
+  uint64_t size;
+  while (pos < end and read_header(&id, &size)) {
+    if (id != ID_CUEPOINT) {
+      if (!skip(size)) return false;
+      continue;
+    }
+    uint64_t const point_end = pos + size;
+    while (pos < point_end and read_header(&id, &size)) {
+      if (id != ID_CUETRACKPOSITIONS) {
+        if (!skip(size)) return false;
+        continue;
+      }
+      uint64_t const positions_end = pos + size;
+      uint64_t track = 0;
+      cue_t cue = {unknown_size, unknown_size};
+      while (pos < positions_end and read_header(&id, &size)) {
+        if (id == ID_CUETRACK)
+          track = read_uint(size);
+        else if (id == ID_CUECLUSTERPOSITION)
+          cue.cluster = read_uint(size);
+        else if (id == ID_CUERELATIVEPOSITION)
+          cue.relative = read_uint(size);
+        else if (!skip(size))
+          return false;
+      }
+      if (track == track_number and cue.cluster != unknown_size)
+        cues.push_back(cue);
+    }
+  }
+  return pos == end;
+}
+
+bool matroska_reader::select(unsigned id) {
+  selected = NULL;
+  for (size_t i = 0; i < vobsub_tracks.size(); ++i) {
+    if (vobsub_tracks[i].id == id) selected = &vobsub_tracks[i];
+  }
+  if (selected == NULL) return false;
+  switch (selected->compression) {
+    case COMPRESSION_NONE:
+    case COMPRESSION_STRIP:
+      break;
+#ifdef HAVE_ZLIB
+    case COMPRESSION_ZLIB:
+      break;
+#endif
+    case COMPRESSION_ENCRYPTED:
+      std::cerr << "Matroska track " << id << " is encrypted\n";
+      selected = NULL;
+      return false;
+    default:
+      std::cerr << "Matroska track " << id
+                << " uses an unsupported compression (" << selected->compression
+                << ")\n";
+      selected = NULL;
+      return false;
+  }
+
+  // The cues usually index every subtitle block, so only those clusters have
+  // to be read instead of the whole file.
+  cues.clear();
+  uint32_t element;
+  uint64_t size;
+  if (seek_cues != unknown_size and seek(segment_start + seek_cues) and
+      read_header(&element, &size) and element == ID_CUES and
+      size != unknown_size and !parse_cues(pos + size, selected->number)) {
+    cues.clear();
+  }
+  std::sort(cues.begin(), cues.end());
+  std::vector<cue_t> merged;
+  for (size_t i = 0; i < cues.size();) {
+    size_t j = i;
+    while (j < cues.size() and cues[j].cluster == cues[i].cluster) ++j;
+    if (cues[j - 1].relative == unknown_size) {
+      merged.push_back(cues[j - 1]);  // read the whole cluster
+    } else {
+      for (size_t k = i; k < j; ++k) {
+        if (k == i or cues[k].relative != cues[k - 1].relative)
+          merged.push_back(cues[k]);
+      }
+    }
+    i = j;
+  }
+  cues.swap(merged);
+  use_cues = !cues.empty();
+  next_cue = 0;
+  cluster = unknown_size;
+  if (use_cues) {
+    scan_end = 0;
+  } else {
+    if (!seek(first_cluster)) return false;
+    scan_end = segment_end;
+  }
+  scan_one_cluster = false;
+  return true;
+}
+
+bool matroska_reader::enter_cluster(uint64_t start) {
+  if (start == cluster) return true;
+  uint32_t id;
+  uint64_t size;
+  if (!seek(start) or !read_header(&id, &size) or id != ID_CLUSTER) {
+    std::cerr << "Matroska: bad cue, no cluster at " << start << '\n';
+    return false;
+  }
+  cluster = start;
+  cluster_data = pos;
+  cluster_end = size == unknown_size ? segment_end : pos + size;
+  cluster_timecode = 0;
+  // the timecode is the first element of a cluster
+  while (pos < cluster_end and read_header(&id, &size)) {
+    if (id == ID_TIMECODE) {
+      cluster_timecode = read_uint(size);
+      break;
+    }
+    if (id == ID_CLUSTER or size == unknown_size or !skip(size)) break;
+  }
+  return true;
+}
+
+int matroska_reader::next_packet(unsigned char **data, unsigned *pts100) {
+  if (selected == NULL) return -1;
+  for (;;) {
+    if (pos < scan_end) {
+      int const res = scan(data, pts100);
+      if (res != 0) return res;
+    }
+    if (!use_cues or next_cue >= cues.size()) return 0;
+
+    cue_t const &cue = cues[next_cue++];
+    if (!enter_cluster(segment_start + cue.cluster)) continue;
+    if (cue.relative == unknown_size) {
+      scan_end = cluster_end;
+      scan_one_cluster = true;
+      if (!seek(cluster_data)) return -1;
+    } else {
+      uint64_t const start = cluster_data + cue.relative;
+      uint32_t id;
+      uint64_t size;
+      if (!seek(start) or !read_header(&id, &size) or size == unknown_size) {
+        std::cerr << "Matroska: bad cue, no block at " << start << '\n';
+        continue;
+      }
+      scan_end = pos + size;
+      scan_one_cluster = false;
+      if (!seek(start)) return -1;
+    }
+  }
+}
+
+int matroska_reader::scan(unsigned char **data, unsigned *pts100) {
+  uint32_t id;
+  uint64_t size;
+  while (pos < scan_end) {
+    uint64_t const start = pos;
+    if (!read_header(&id, &size)) {
+      // a segment of unknown size simply ends with the file
+      if (feof(file) and scan_end == unknown_size) return 0;
+      std::cerr << "Matroska: broken or truncated file '" << filename
+                << "' at " << start << '\n';
+      return -1;
+    }
+    switch (id) {
+      case ID_CLUSTER:
+        if (scan_one_cluster) {
+          scan_end = start;
+          return 0;
+        }
+        cluster = start;
+        cluster_data = pos;
+        cluster_end = size == unknown_size ? segment_end : pos + size;
+        cluster_timecode = 0;
+        break;  // read the blocks inside
+      case ID_BLOCKGROUP:
+        break;
+      case ID_TIMECODE:
+        cluster_timecode = read_uint(size);
+        break;
+      case ID_BLOCK:
+      case ID_SIMPLEBLOCK: {
+        int const res = read_block(size, data, pts100);
+        if (res != 0) return res;
+        break;
+      }
+      default:
+        if (size == unknown_size) {
+          std::cerr << "Matroska: element " << std::hex << id << std::dec
+                    << " of unknown size in '" << filename << "'\n";
+          return -1;
+        }
+        if (!skip(size)) return -1;
+    }
+  }
+  return 0;
+}
+
+/// Returns the size of the packet if the block belongs to the selected track
+/// and 0 if it was skipped.
+int matroska_reader::read_block(uint64_t size, unsigned char **data,
+                                unsigned *pts100) {
+  uint64_t const end = pos + size;
+  unsigned char b[8];
+  // track number (EBML variable size integer), timecode, flags
+  if (size < 4 or !read(b, 1)) return -1;
+  unsigned len = 1;
+  while (len <= 8 and !(b[0] & (0x100 >> len))) ++len;
+  if (len > 8 or (len > 1 and !read(b + 1, len - 1))) return -1;
+  uint64_t track = b[0] & (0xff >> len);
+  for (unsigned i = 1; i < len; ++i) track = track << 8 | b[i];
+  if (track != selected->number) return skip(end - pos) ? 0 : -1;
+
+  if (end < pos + 3 or !read(b, 3)) return -1;
+  int const relative = static_cast<int16_t>(b[0] << 8 | b[1]);
+  if (b[2] & 0x06) {
+    std::cerr << "WARNING: Matroska: skipping laced subtitle block\n";
+    return skip(end - pos) ? 0 : -1;
+  }
+  if (!read_data(end - pos, block)) return -1;
+
+  std::vector<unsigned char> *packet = &block;
+  if (selected->compression != COMPRESSION_NONE) {
+    if (!decode(*selected, block, decoded)) {
+      std::cerr << "WARNING: Matroska: skipping broken subtitle block\n";
+      return 0;
+    }
+    packet = &decoded;
+  }
+  if (packet->empty() or packet->size() > INT_MAX) return 0;
+
+  long long timecode = static_cast<long long>(cluster_timecode) + relative;
+  if (timecode < 0) timecode = 0;
+  // pts100 has a 90 kHz resolution, the timecodes are in timecode_scale ns
+  *pts100 = static_cast<uint64_t>(timecode) * timecode_scale * 9 / 100000;
+  *data = packet->data();
+  return static_cast<int>(packet->size());
+}
+
+bool matroska_reader::decode(mkv_track_t const &track,
+                             std::vector<unsigned char> &in,
+                             std::vector<unsigned char> &out) const {
+  switch (track.compression) {
+    case COMPRESSION_STRIP:
+      out.assign(track.stripped_header.begin(), track.stripped_header.end());
+      out.insert(out.end(), in.begin(), in.end());
+      return true;
+#ifdef HAVE_ZLIB
+    case COMPRESSION_ZLIB: {
+      z_stream z;
+      memset(&z, 0, sizeof(z));
+      if (inflateInit(&z) != Z_OK) return false;
+      z.next_in = in.data();
+      z.avail_in = in.size();
+      out.resize(std::max<size_t>(4 * in.size(), 4096));
+      size_t done = 0;
+      int res;
+      do {
+        z.next_out = out.data() + done;
+        z.avail_out = out.size() - done;
+        res = inflate(&z, Z_NO_FLUSH);
+        done = out.size() - z.avail_out;
+        if (res == Z_OK and z.avail_out == 0) {
+          if (out.size() >= max_data_size) res = Z_MEM_ERROR;
+          out.resize(2 * out.size());
+        } else if (res == Z_OK) {
+          res = Z_DATA_ERROR;  // truncated
+        }
+      } while (res == Z_OK);
+      inflateEnd(&z);
+      out.resize(done);
+      return res == Z_STREAM_END;
+    }
+#endif
+    default:
+      return false;
+  }
+}
@@ -0,0 +1,117 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MATROSKA_HXX
+#define MATROSKA_HXX
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// A VobSub (S_VOBSUB) track of a Matroska file
+struct mkv_track_t {
+  unsigned id;      ///< position in the track list (same as mkvmerge's IDs)
+  unsigned number;  ///< track number used by the blocks
+  std::string language;  ///< ISO 639-2 code or IETF language tag
+  std::string name;
+  std::vector<unsigned char> codec_private;  ///< the .idx file header
+  int compression;  ///< ContentCompAlgo of the blocks, -1 if uncompressed
+  std::vector<unsigned char> stripped_header;  ///< for header stripping (3)
+};
+
+/// True if the file name has a Matroska extension (.mkv, .mks or .webm)
+bool is_matroska_file(std::string const &filename);
+
+/// Reads the VobSub blocks of a Matroska file without extracting the track.
+/// Uses the cues to jump to the subtitle blocks if the file has an index for
+/// the track and otherwise reads the clusters sequentially.
+struct matroska_reader {
+  matroska_reader();
+  ~matroska_reader();
+
+  /// Opens the file and reads the track list. Prints an error on failure.
+  bool open(std::string const &filename);
+  std::vector<mkv_track_t> const &tracks() const { return vobsub_tracks; }
+  /// Selects the VobSub track with the given id
+  bool select(unsigned id);
+  /// Reads the next block of the selected track. Returns the size of the SPU
+  /// packet, 0 at the end of the file and -1 on errors. The data is valid
+  /// until the next call.
+  int next_packet(unsigned char **data, unsigned *pts100);
+
+ private:
+  struct cue_t {
+    uint64_t cluster;   // relative to the segment data
+    uint64_t relative;  // block position in the cluster, unknown_size if none
+    bool operator<(cue_t const &o) const {
+      return cluster < o.cluster or
+             (cluster == o.cluster and relative < o.relative);
+    }
+  };
+
+  bool read(void *buf, size_t size);
+  bool seek(uint64_t to);
+  bool skip(uint64_t size);
+  bool read_header(uint32_t *id, uint64_t *size);
+  uint64_t read_uint(uint64_t size);
+  bool read_data(uint64_t size, std::vector<unsigned char> &data);
+  bool read_string(uint64_t size, std::string &str);
+  bool parse_level1(uint32_t id, uint64_t size);
+  bool parse_seek_head(uint64_t end);
+  bool parse_info(uint64_t end);
+  bool parse_tracks(uint64_t end);
+  bool parse_track_entry(uint64_t end);
+  bool parse_content_encodings(uint64_t end, mkv_track_t &track, int *scope);
+  bool parse_cues(uint64_t end, unsigned track_number);
+  bool enter_cluster(uint64_t cluster);
+  int scan(unsigned char **data, unsigned *pts100);
+  int read_block(uint64_t size, unsigned char **data, unsigned *pts100);
+  bool decode(mkv_track_t const &track, std::vector<unsigned char> &in,
+              std::vector<unsigned char> &out) const;
+
+  FILE *file;
+  std::string filename;
+  uint64_t pos;            // file position
+  uint64_t segment_start;  // file position of the segment data
+  uint64_t segment_end;
+  uint64_t first_cluster;
+  uint64_t seek_info, seek_tracks, seek_cues;  // from the SeekHead
+  bool have_info, have_tracks;
+  uint64_t timecode_scale;  // ns per timecode unit
+  std::vector<mkv_track_t> vobsub_tracks;
+
+  mkv_track_t const *selected;
+  std::vector<cue_t> cues;  // of the selected track
+  size_t next_cue;
+  bool use_cues;
+  uint64_t scan_end;      // scan reads elements up to here
+  bool scan_one_cluster;  // and stops at the next cluster if this is set
+  uint64_t cluster, cluster_data, cluster_end;  // current cluster
+  uint64_t cluster_timecode;
+  std::vector<unsigned char> block, decoded;
+
+  // noncopyable
+  matroska_reader(matroska_reader const &);
+  matroska_reader &operator=(matroska_reader const &);
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "memory.h++"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+#ifdef DEBUG
+thread_local unsigned long new_calls = 0;  // outside of a buffer_growth
+thread_local unsigned growing = 0;  // nesting depth of buffer_growth
+#endif
+
+// Pool buffers grow in pages, so that images of about the same size fit
+size_t round_up(size_t size) {
+  enum { granularity = 4096 };
+  return (size + granularity - 1) / granularity * granularity;
+}
+}  // namespace
+
+#ifdef DEBUG
+// Counts the calls per thread for hot_path_check
+void *operator new(size_t size) {
+  if (growing == 0) ++new_calls;
+  if (size == 0) size = 1;
+  for (;;) {
+    if (void *p = malloc(size)) return p;
+    new_handler const handler = get_new_handler();
+    if (handler == NULL) throw bad_alloc();
+    handler();
+  }
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, nothrow_t const &) noexcept {
+  try {
+    return operator new(size);
+  } catch (...) {
+    return NULL;
+  }
+}
+
+void *operator new[](size_t size, nothrow_t const &) noexcept {
+  return operator new(size, nothrow);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, nothrow_t const &) noexcept { free(p); }
+void operator delete[](void *p, nothrow_t const &) noexcept { free(p); }
+#endif
+
+void memory_counter::add(size_t size) {
+  uint64_t const now = bytes += size;
+  uint64_t old = peak;
+  while (now > old and !peak.compare_exchange_weak(old, now)) {
+  }
+}
+
+void memory_counter::set(uint64_t size, unsigned long allocations,
+                         uint64_t peak) {
+  bytes = 0;
+  add(size > peak ? size : peak);
+  bytes = size;
+  this->allocations = allocations;
+}
+
+buffer_pool::~buffer_pool() {
+  for (size_t i = 0; i < free_buffers.size(); ++i) {
+    free(free_buffers[i].first);
+    counter->release(free_buffers[i].second);
+  }
+}
+
+unsigned char *buffer_pool::acquire(size_t size, size_t *capacity) {
+  unique_lock<mutex> lock(mut);
+  // the smallest free buffer that fits
+  size_t best = free_buffers.size();
+  for (size_t i = 0; i < free_buffers.size(); ++i) {
+    if (free_buffers[i].second >= size and
+        (best == free_buffers.size() or
+         free_buffers[i].second < free_buffers[best].second))
+      best = i;
+  }
+  if (best < free_buffers.size()) {
+    unsigned char *const buffer = free_buffers[best].first;
+    *capacity = free_buffers[best].second;
+    free_buffers[best] = free_buffers.back();
+    free_buffers.pop_back();
+    return buffer;
+  }
+  // none is large enough: replace the largest, so the number of buffers
+  // stays put
+  if (!free_buffers.empty()) {
+    size_t largest = 0;
+    for (size_t i = 1; i < free_buffers.size(); ++i) {
+      if (free_buffers[i].second > free_buffers[largest].second) largest = i;
+    }
+    free(free_buffers[largest].first);
+    counter->release(free_buffers[largest].second);
+    free_buffers[largest] = free_buffers.back();
+    free_buffers.pop_back();
+  }
+  lock.unlock();
+  *capacity = round_up(size);
+  unsigned char *const buffer = static_cast<unsigned char *>(malloc(*capacity));
+  if (buffer == NULL) throw bad_alloc();
+  counter->allocate(*capacity);
+  return buffer;
+}
+
+void buffer_pool::release(unsigned char *buffer, size_t capacity) {
+  if (buffer == NULL) return;
+  lock_guard<mutex> lock(mut);
+  if (free_buffers.size() < free_buffers.capacity()) {
+    free_buffers.push_back(make_pair(buffer, capacity));
+  } else {
+    buffer_growth growing;
+    free_buffers.push_back(make_pair(buffer, capacity));
+  }
+}
+
+uint64_t resident_bytes() {
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == NULL) return 0;
+  unsigned long size = 0, resident = 0;
+  int const n = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  if (n != 2) return 0;
+  return static_cast<uint64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+uint64_t peak_resident_bytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) < 0) return 0;
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // in KiB on Linux
+}
+
+buffer_growth::buffer_growth() {
+#ifdef DEBUG
+  ++growing;
+#endif
+}
+
+buffer_growth::~buffer_growth() {
+#ifdef DEBUG
+  --growing;
+#endif
+}
+
+void hot_path_check::begin() {
+#ifdef DEBUG
+  if (!enabled) return;
+  active = true;
+  new_calls = ::new_calls;
+#endif
+}
+
+void hot_path_check::end() {
+#ifdef DEBUG
+  if (!active) return;
+  active = false;
+  assert(::new_calls == new_calls);
+#endif
+}
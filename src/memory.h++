@@ -0,0 +1,111 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MEMORY_HXX
+#define MEMORY_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/// Bytes held by one kind of buffer, their high-water mark and the number of
+/// allocations made for them (--stats). Thread safe.
+struct memory_counter {
+  memory_counter() : bytes(0), peak(0), allocations(0) {}
+
+  /// Counts a new buffer of size bytes
+  void allocate(size_t size) {
+    ++allocations;
+    add(size);
+  }
+  /// Adds size bytes that are now in use (e.g. a reused buffer)
+  void add(size_t size);
+  void release(size_t size) { bytes -= size; }
+  /// Takes over the numbers of a counter kept elsewhere (e.g. by spudec)
+  void set(uint64_t size, unsigned long allocations, uint64_t peak = 0);
+
+  std::atomic<uint64_t> bytes, peak;
+  std::atomic<unsigned long> allocations;
+
+ private:
+  memory_counter(memory_counter const &);  // noncopyable
+  memory_counter &operator=(memory_counter const &);
+};
+
+/// Image buffers that are handed from thread to thread and reused, so that a
+/// conversion allocates only until the largest images have been seen. A
+/// buffer smaller than the request is replaced. Thread safe.
+struct buffer_pool {
+  explicit buffer_pool(memory_counter *counter) : counter(counter) {}
+  ~buffer_pool();
+
+  /// A buffer of at least size bytes. Its real size goes to *capacity and has
+  /// to be passed back to release(). Throws std::bad_alloc like new.
+  unsigned char *acquire(size_t size, size_t *capacity);
+  /// Keeps the buffer for the next acquire(). Ignores NULL.
+  void release(unsigned char *buffer, size_t capacity);
+
+ private:
+  buffer_pool(buffer_pool const &);  // noncopyable
+  buffer_pool &operator=(buffer_pool const &);
+
+  memory_counter *counter;  // counts all buffers, in use or free
+  std::mutex mut;
+  std::vector<std::pair<unsigned char *, size_t> > free_buffers;
+};
+
+/// Size of the process in memory (resident set) in bytes, 0 if unknown
+uint64_t resident_bytes();
+/// Largest resident set so far in bytes
+uint64_t peak_resident_bytes();
+
+/// Encloses the growth of a buffer or table (or the start of an OCR thread).
+/// The allocations of the calling thread meanwhile are not counted by the
+/// hot path check, all others are.
+struct buffer_growth {
+  buffer_growth();
+  ~buffer_growth();
+
+ private:
+  buffer_growth(buffer_growth const &);  // noncopyable
+  buffer_growth &operator=(buffer_growth const &);
+};
+
+/// Debug builds check that the per-subtitle path of the main thread does not
+/// allocate on the heap (operator new) outside of a buffer_growth. The
+/// buffer_pool buffers come from malloc and are not counted. begin() and
+/// end() enclose the path. Does nothing in release builds.
+struct hot_path_check {
+  hot_path_check() : enabled(false), active(false), new_calls(0) {}
+  void begin();
+  void end();
+
+  bool enabled;  ///< off for options that allocate by design (e.g. --trace)
+
+ private:
+  bool active;
+  unsigned long new_calls;
+};
+
+#endif
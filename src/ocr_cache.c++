@@ -0,0 +1,323 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ocr_cache.h++"
+#include "record_file.h++"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+char const file_magic[8] = {'V', '2', 'S', 'O', 'C', 'R', '\0', '\1'};
+// record types
+enum : uint32_t {
+  RECORD_RESULT = 0x52533256,  // "V2SR"
+  RECORD_TOUCH = 0x54533256    // "V2ST"
+};
+// record header: magic, text length, image hash, settings hash, words, mean,
+// min, check (hash of the header before it and the text)
+enum { header_size = 40 };
+
+// Holds an flock for its lifetime
+struct file_lock {
+  file_lock(int fd, int operation) : fd(fd) {
+    while (flock(fd, operation) < 0 and errno == EINTR) {
+    }
+  }
+  ~file_lock() { flock(fd, LOCK_UN); }
+  int fd;
+};
+
+bool write_all(int fd, vector<unsigned char> const &data) {
+  return ::write_all(fd, data.data(), data.size());
+}
+}  // namespace
+
+uint64_t image_hash(unsigned char const *image, unsigned width,
+                    unsigned height, unsigned stride) {
+  unsigned const dimensions[2] = {width, height};
+  uint64_t hash = hash_bytes(dimensions, sizeof(dimensions));
+  for (unsigned y = 0; y < height; ++y)
+    hash = hash_bytes(image + y * stride, width, hash);
+  return hash;
+}
+
+ocr_cache::ocr_cache()
+    : hits(0),
+      misses(0),
+      fd(-1),
+      settings(0),
+      max_size(0),
+      scanned_end(0),
+      sequence(0) {}
+
+ocr_cache::~ocr_cache() { close(); }
+
+bool ocr_cache::open(string const &filename, string const &settings,
+                     uint64_t max_size) {
+  this->filename = filename;
+  this->settings = hash_bytes(settings.data(), settings.size());
+  this->max_size = max_size;
+  if (!reopen()) {
+    cerr << "Can't open OCR cache " << filename << ": " << strerror(errno)
+         << '\n';
+    return false;
+  }
+  file_lock lock(fd, LOCK_EX);
+  struct stat st;
+  if (fstat(fd, &st) == 0 and st.st_size == 0 and
+      !write_all(fd, file_magic, sizeof(file_magic))) {
+    cerr << "Can't write OCR cache " << filename << '\n';
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  if (!scan(true)) {
+    cerr << filename << " is not an OCR cache\n";
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  return true;
+}
+
+bool ocr_cache::reopen() {
+  if (fd >= 0) ::close(fd);
+  fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  index.clear();
+  scanned_end = 0;
+  return fd >= 0;
+}
+
+// Reads the records after scanned_end. A broken record at the end (e.g. from
+// a killed process) is cut off if may_truncate is set (needs LOCK_EX).
+bool ocr_cache::scan(bool may_truncate) {
+  struct stat st;
+  if (fstat(fd, &st) < 0) return false;
+  uint64_t const size = st.st_size;
+  if (scanned_end == 0) {
+    char magic[sizeof(file_magic)];
+    if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic) or
+        memcmp(magic, file_magic, sizeof(magic)) != 0)
+      return false;
+    scanned_end = sizeof(file_magic);
+  }
+  if (size <= scanned_end) return true;
+  vector<unsigned char> data(size - scanned_end);
+  if (pread(fd, data.data(), data.size(), scanned_end) !=
+      static_cast<ssize_t>(data.size()))
+    return false;
+  size_t pos = 0;
+  while (data.size() - pos >= header_size) {
+    unsigned char const *header = &data[pos];
+    uint32_t const magic = get<uint32_t>(header);
+    uint32_t const text_len = get<uint32_t>(header + 4);
+    if ((magic != RECORD_RESULT and magic != RECORD_TOUCH) or
+        text_len > data.size() - pos - header_size)
+      break;
+    char const *text = reinterpret_cast<char const *>(header + header_size);
+    if (get<uint32_t>(header + 36) !=
+        record_check(header, header_size, text, text_len))
+      break;
+    key_t const key = {get<uint64_t>(header + 8), get<uint64_t>(header + 16)};
+    if (magic == RECORD_RESULT) {
+      slot_t &slot = index[key];
+      slot.entry.text.assign(text, text_len);
+      slot.entry.words = get<uint32_t>(header + 24);
+      slot.entry.mean = get<float>(header + 28);
+      slot.entry.min = get<float>(header + 32);
+      slot.used = ++sequence;
+    } else {
+      auto const i = index.find(key);
+      if (i != index.end()) i->second.used = ++sequence;
+    }
+    pos += header_size + text_len;
+  }
+  if (pos < data.size() and may_truncate) {
+    cerr << "WARNING: dropping " << data.size() - pos
+         << " broken bytes at the end of " << filename << '\n';
+    if (ftruncate(fd, scanned_end + pos) < 0) return false;
+  }
+  scanned_end += pos;
+  return true;
+}
+
+bool ocr_cache::lookup(uint64_t image, ocr_cache_entry_t *entry) {
+  lock_guard<mutex> guard(mut);
+  if (fd < 0) return false;
+  key_t const key = {image, settings};
+  auto i = index.find(key);
+  if (i == index.end()) {
+    // maybe another process has recognized it in the meantime
+    struct stat st;
+    if (fstat(fd, &st) == 0 and uint64_t(st.st_size) > scanned_end) {
+      file_lock lock(fd, LOCK_SH);
+      scan(false);
+      i = index.find(key);
+    }
+  }
+  if (i == index.end()) {
+    ++misses;
+    return false;
+  }
+  ++hits;
+  *entry = i->second.entry;
+  i->second.used = ++sequence;
+  if (!i->second.touched) {
+    i->second.touched = true;
+    append(make_record(RECORD_TOUCH, key, NULL));
+    limit_size();
+  }
+  return true;
+}
+
+void ocr_cache::insert(uint64_t image, ocr_cache_entry_t const &entry) {
+  lock_guard<mutex> guard(mut);
+  if (fd < 0) return;
+  key_t const key = {image, settings};
+  slot_t &slot = index[key];
+  slot.entry = entry;
+  slot.used = ++sequence;
+  slot.touched = true;
+  append(make_record(RECORD_RESULT, key, &entry));
+  limit_size();
+}
+
+vector<unsigned char> ocr_cache::make_record(uint32_t magic, key_t const &key,
+                                             ocr_cache_entry_t const *entry) {
+  string const text = entry ? entry->text : string();
+  vector<unsigned char> record(header_size + text.size());
+  unsigned char *header = record.data();
+  put<uint32_t>(header, magic);
+  put<uint32_t>(header + 4, text.size());
+  put<uint64_t>(header + 8, key.image);
+  put<uint64_t>(header + 16, key.settings);
+  put<uint32_t>(header + 24, entry ? entry->words : 0);
+  put<float>(header + 28, entry ? entry->mean : 0.0f);
+  put<float>(header + 32, entry ? entry->min : 0.0f);
+  memcpy(header + header_size, text.data(), text.size());
+  put<uint32_t>(header + 36, record_check(header, header_size, text.data(),
+                                          text.size()));
+  return record;
+}
+
+bool ocr_cache::append(vector<unsigned char> const &record) {
+  file_lock lock(fd, LOCK_EX);
+  // another process may have compacted the cache into a new file
+  struct stat st, path_st;
+  if (stat(filename.c_str(), &path_st) == 0 and fstat(fd, &st) == 0 and
+      st.st_ino == path_st.st_ino and st.st_dev == path_st.st_dev)
+    return write_record(record);
+  std::unordered_map<key_t, slot_t, key_hash> const ours = index;
+  if (!reopen()) return false;
+  file_lock new_lock(fd, LOCK_EX);
+  if (fstat(fd, &st) == 0 and st.st_size == 0)
+    write_all(fd, file_magic, sizeof(file_magic));
+  for (auto const &i : ours) index.insert(i);
+  return write_record(record);
+}
+
+// Catches up with the records of other processes first so that scanned_end
+// can move past our own record (needs LOCK_EX)
+bool ocr_cache::write_record(vector<unsigned char> const &record) {
+  if (!scan(true)) return false;
+  if (!write_all(fd, record)) return false;
+  scanned_end += record.size();
+  return true;
+}
+
+// Rewrites the file with the most recently used entries, filling half of the
+// size limit so that compactions are rare.
+bool ocr_cache::compact() {
+  file_lock lock(fd, LOCK_EX);
+  scan(true);
+  vector<pair<uint64_t, key_t>> order;
+  order.reserve(index.size());
+  for (auto const &i : index)
+    order.push_back(make_pair(i.second.used, i.first));
+  sort(order.begin(), order.end(),
+       [](pair<uint64_t, key_t> const &a, pair<uint64_t, key_t> const &b) {
+         return a.first > b.first;
+       });
+  uint64_t size = sizeof(file_magic);
+  size_t keep = 0;
+  while (keep < order.size()) {
+    size += header_size + index[order[keep].second].entry.text.size();
+    if (size > max_size / 2) break;
+    ++keep;
+  }
+  // a unique name, other processes may be compacting the same cache
+  string tmp_name = filename + ".XXXXXX";
+  int const tmp = mkstemp(&tmp_name[0]);
+  bool ok = tmp >= 0 and fchmod(tmp, 0644) == 0 and
+            write_all(tmp, file_magic, sizeof(file_magic));
+  // oldest first, so the order of use survives the next scan
+  for (size_t i = keep; ok and i-- > 0;) {
+    key_t const &key = order[i].second;
+    ok = write_all(tmp, make_record(RECORD_RESULT, key, &index[key].entry));
+  }
+  if (tmp >= 0 and ::close(tmp) < 0) ok = false;
+  if (!ok or rename(tmp_name.c_str(), filename.c_str()) < 0) {
+    cerr << "WARNING: could not compact OCR cache " << filename << '\n';
+    if (tmp >= 0) unlink(tmp_name.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Keeps the file within the size limit while it is in use, not just when it
+// is closed (a long or killed run would grow it without bound otherwise).
+// Continues with the compacted file.
+void ocr_cache::limit_size() {
+  if (max_size == 0 or scanned_end <= max_size) return;
+  if (!compact()) {
+    max_size = 0;  // don't retry on every record
+    return;
+  }
+  if (reopen()) {
+    file_lock lock(fd, LOCK_SH);
+    if (scan(false)) return;
+  }
+  cerr << "WARNING: can't reopen OCR cache " << filename << '\n';
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+}
+
+void ocr_cache::close() {
+  lock_guard<mutex> guard(mut);
+  if (fd < 0) return;
+  struct stat st;
+  if (max_size > 0 and fstat(fd, &st) == 0 and uint64_t(st.st_size) > max_size)
+    compact();
+  ::close(fd);
+  fd = -1;
+}
@@ -0,0 +1,108 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OCR_CACHE_HXX
+#define OCR_CACHE_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Hash of the pixels and dimensions of an image (independent of the stride)
+uint64_t image_hash(unsigned char const *image, unsigned width,
+                    unsigned height, unsigned stride);
+
+/// A cached OCR result
+struct ocr_cache_entry_t {
+  std::string text;
+  unsigned words;
+  float mean, min;  ///< word confidences
+};
+
+/// Persistent OCR results, keyed by the image hash and a hash of the OCR
+/// settings. The file is an append-only log of records that is read into an
+/// in-memory index on open. Several processes can share it: appends are done
+/// under an exclusive flock and records other processes added are picked up
+/// on a miss. When the file grows beyond the size limit (checked on every
+/// append and on close) it is rewritten with the most recently used entries
+/// (hits append a small touch record).
+struct ocr_cache {
+  ocr_cache();
+  ~ocr_cache();
+
+  /// Opens or creates the cache. Only entries recognized with the same
+  /// settings (e.g. language, engine mode, blacklist and dpi) are returned.
+  /// Prints an error on failure.
+  bool open(std::string const &filename, std::string const &settings,
+            uint64_t max_size);
+  /// Looks the image up. Thread safe.
+  bool lookup(uint64_t image, ocr_cache_entry_t *entry);
+  /// Adds a result. Thread safe.
+  void insert(uint64_t image, ocr_cache_entry_t const &entry);
+  /// Compacts the file if it is too large and closes it
+  void close();
+  bool is_open() const { return fd >= 0; }
+
+  unsigned hits, misses;
+
+ private:
+  struct key_t {
+    uint64_t image, settings;
+    bool operator==(key_t const &o) const {
+      return image == o.image and settings == o.settings;
+    }
+  };
+  struct key_hash {
+    size_t operator()(key_t const &k) const { return k.image ^ k.settings; }
+  };
+  struct slot_t {
+    ocr_cache_entry_t entry;
+    uint64_t used;  // sequence number of the last record or touch
+    bool touched;   // touch record written in this run
+  };
+
+  bool reopen();
+  bool scan(bool may_truncate);
+  static std::vector<unsigned char> make_record(
+      uint32_t magic, key_t const &key, ocr_cache_entry_t const *entry);
+  bool append(std::vector<unsigned char> const &record);
+  bool write_record(std::vector<unsigned char> const &record);
+  bool compact();
+  void limit_size();
+
+  std::mutex mut;
+  int fd;
+  std::string filename;
+  uint64_t settings;
+  uint64_t max_size;
+  uint64_t scanned_end;  // the index contains the records up to here
+  uint64_t sequence;
+  std::unordered_map<key_t, slot_t, key_hash> index;
+
+  // noncopyable
+  ocr_cache(ocr_cache const &);
+  ocr_cache &operator=(ocr_cache const &);
+};
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ocr_engine.h++"
+#include "ocr_cache.h++"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "leptonica/allheaders.h"
+#include "tesseract/baseapi.h"
+#include "tesseract/ocrclass.h"
+#include "tesseract/resultiterator.h"
+
+using namespace std;
+using namespace tesseract;
+
+int const tesseract_psm_count = PSM_COUNT;
+int const tesseract_default_psm = PSM_SINGLE_BLOCK;
+
+namespace {
+struct tesseract_engine : ocr_engine {
+  tesseract_engine() : api(NULL), pix(NULL), pix_words(0), dpi(0) {
+    conf.words = 0;
+    conf.mean = conf.min = 0.0f;
+  }
+  ~tesseract_engine() {
+    pixDestroy(&pix);
+    if (api) {
+      api->End();
+      delete api;
+    }
+  }
+
+  bool init(ocr_engine_config_t const &config) {
+    OcrEngineMode oem = OEM_DEFAULT;
+    switch (config.oem) {
+      case 0:
+        oem = OEM_TESSERACT_ONLY;
+        break;
+      case 1:
+        oem = OEM_LSTM_ONLY;
+        break;
+      case 2:
+        oem = OEM_TESSERACT_LSTM_COMBINED;
+        break;
+    }
+    api = new TessBaseAPI();
+    if (api->Init(config.data_path.empty() ? NULL : config.data_path.c_str(),
+                  config.lang.c_str(), oem) == -1) {
+      delete api;
+      api = NULL;
+      cerr << "Failed to initialize tesseract (OCR).\n";
+      return false;
+    }
+    if (!config.blacklist.empty())
+      api->SetVariable("tessedit_char_blacklist", config.blacklist.c_str());
+    dpi = config.dpi;
+    char dpi_string[16];
+    snprintf(dpi_string, sizeof(dpi_string), "%d", dpi);
+    api->SetVariable("user_defined_dpi", dpi_string);
+    // Subtitles are one to three lines of text, a full page layout analysis
+    // only costs time and sometimes splits a line into columns.
+    api->SetPageSegMode(static_cast<PageSegMode>(config.psm));
+    return true;
+  }
+
+  // Tesseract checks the monitor between words, which lets it give up after
+  // the timeout. The API is always cleared so that the Pix can be refilled.
+  char *recognize(unsigned char const *image, unsigned width, unsigned height,
+                  unsigned stride, int timeout_ms, bool *timed_out) {
+    *timed_out = false;
+    conf.words = 0;
+    conf.mean = conf.min = 0.0f;
+    if (!fill_pix(image, width, height, stride)) return NULL;
+    ETEXT_DESC monitor;
+    if (timeout_ms > 0) monitor.set_deadline_msecs(timeout_ms);
+    api->SetImage(pix);
+    int const res = api->Recognize(&monitor);
+    *timed_out = timeout_ms > 0 and monitor.deadline_exceeded();
+    char *text = NULL;
+    if (res >= 0 and !*timed_out) {
+      text = api->GetUTF8Text();
+      word_confidence();
+    }
+    api->Clear();
+    return text;
+  }
+
+  ocr_confidence_t confidence() const { return conf; }
+
+  // just the version, which keeps the OCR caches of earlier releases valid
+  string version() const { return TessBaseAPI::Version(); }
+
+ private:
+  // Copies the image into the 8 bpp Pix. The Pix only grows, smaller images
+  // reuse its buffer by shrinking the dimensions.
+  bool fill_pix(unsigned char const *image, unsigned width, unsigned height,
+                unsigned stride) {
+    l_int32 const wpl = (width + 3) / 4;
+    size_t const words = static_cast<size_t>(wpl) * height;
+    if (words > pix_words) {
+      pixDestroy(&pix);
+      pix = pixCreateNoInit(width, height, 8);
+      if (pix == NULL) {
+        pix_words = 0;
+        return false;
+      }
+      pix_words = words;
+    }
+    pixSetWidth(pix, width);
+    pixSetHeight(pix, height);
+    pixSetWpl(pix, wpl);
+    pixSetResolution(pix, dpi, dpi);
+    l_uint32 *line = pixGetData(pix);
+    for (unsigned y = 0; y < height; ++y, line += wpl) {
+      unsigned char const *row = image + y * stride;
+      for (unsigned x = 0; x < width; ++x) SET_DATA_BYTE(line, x, row[x]);
+    }
+    return true;
+  }
+
+  // Collects the word confidences of the last recognition
+  void word_confidence() {
+    ResultIterator *it = api->GetIterator();
+    if (it == NULL) return;
+    float sum = 0.0f;
+    do {
+      if (it->Empty(RIL_WORD)) continue;
+      float const c = it->Confidence(RIL_WORD);
+      if (conf.words == 0 or c < conf.min) conf.min = c;
+      sum += c;
+      ++conf.words;
+    } while (it->Next(RIL_WORD));
+    delete it;
+    if (conf.words > 0) conf.mean = sum / conf.words;
+  }
+
+  TessBaseAPI *api;
+  Pix *pix;          // reused for every image, see fill_pix
+  size_t pix_words;  // allocated size of pix in 32 bit words
+  int dpi;
+  ocr_confidence_t conf;
+};
+
+// Doesn't recognize anything: the text and confidences are made from the hash
+// of the image, so they are stable across runs, thread counts and machines.
+// The latency is spent spinning, like a CPU bound engine would.
+struct fake_engine : ocr_engine {
+  fake_engine() : latency_ms(0) {
+    conf.words = 0;
+    conf.mean = conf.min = 0.0f;
+  }
+
+  bool init(ocr_engine_config_t const &config) {
+    latency_ms = max(0, config.latency_ms);
+    return true;
+  }
+
+  char *recognize(unsigned char const *image, unsigned width, unsigned height,
+                  unsigned stride, int timeout_ms, bool *timed_out) {
+    uint64_t const hash = image_hash(image, width, height, stride);
+    int busy_ms = latency_ms;
+    *timed_out = timeout_ms > 0 and busy_ms > timeout_ms;
+    if (*timed_out) busy_ms = timeout_ms;
+    chrono::steady_clock::time_point const until =
+        chrono::steady_clock::now() + chrono::milliseconds(busy_ms);
+    while (chrono::steady_clock::now() < until) {
+    }
+    conf.words = 0;
+    conf.mean = conf.min = 0.0f;
+    if (*timed_out) return NULL;
+    char *text = new char[40];
+    snprintf(text, 40, "FAKE %08X %08X\n", unsigned(hash >> 32),
+             unsigned(hash & 0xffffffff));
+    conf.words = 3;
+    conf.mean = 50 + hash % 50;
+    conf.min = conf.mean - (hash >> 8) % 20;
+    return text;
+  }
+
+  ocr_confidence_t confidence() const { return conf; }
+
+  string version() const { return "fake"; }
+
+ private:
+  int latency_ms;
+  ocr_confidence_t conf;
+};
+}  // namespace
+
+bool parse_ocr_engine(string const &name, ocr_engine_type_t *type) {
+  if (name == "tesseract")
+    *type = ENGINE_TESSERACT;
+  else if (name == "fake")
+    *type = ENGINE_FAKE;
+  else
+    return false;
+  return true;
+}
+
+ocr_engine *ocr_engine::create(ocr_engine_type_t type) {
+  switch (type) {
+    case ENGINE_FAKE:
+      return new fake_engine;
+    case ENGINE_TESSERACT:
+      break;
+  }
+  return new tesseract_engine;
+}
+
+ocr_engine::~ocr_engine() {}
@@ -0,0 +1,82 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OCR_ENGINE_HXX
+#define OCR_ENGINE_HXX
+
+#include <string>
+
+/// Engines of --ocr-engine
+enum ocr_engine_type_t { ENGINE_TESSERACT, ENGINE_FAKE };
+
+/// Parses an --ocr-engine name ("tesseract" or "fake")
+bool parse_ocr_engine(std::string const &name, ocr_engine_type_t *type);
+
+/// Page segmentation modes of tesseract (PSM_*): the number of them and the
+/// default for subtitles (PSM_SINGLE_BLOCK)
+extern int const tesseract_psm_count;
+extern int const tesseract_default_psm;
+
+/// Word confidences (0-100) reported by the engine for one image
+struct ocr_confidence_t {
+  unsigned words;   ///< number of recognized words
+  float mean, min;  ///< both 0 if there are no words
+};
+
+/// What an engine is set up with
+struct ocr_engine_config_t {
+  std::string data_path;  ///< of the models, empty for the built-in default
+  std::string lang;
+  std::string blacklist;  ///< characters never to recognize
+  int oem, psm, dpi;      ///< tesseract engine mode, segmentation and dpi
+  int latency_ms;         ///< time the fake engine takes per image
+};
+
+/// An OCR engine. Engines are not thread safe, every OCR thread creates its
+/// own.
+struct ocr_engine {
+  /// Creates an engine of the type, init has to be called before use
+  static ocr_engine *create(ocr_engine_type_t type);
+  virtual ~ocr_engine();
+
+  /// Loads the models. Prints an error and returns false on failure.
+  virtual bool init(ocr_engine_config_t const &config) = 0;
+  /// Recognizes the 8 bit gray image (dark text on white). Gives up after
+  /// timeout_ms (0: no limit) and sets timed_out if the time was the reason.
+  /// Returns the UTF-8 text (delete[]) or NULL on failure.
+  virtual char *recognize(unsigned char const *image, unsigned width,
+                          unsigned height, unsigned stride, int timeout_ms,
+                          bool *timed_out) = 0;
+  /// Word confidences of the last recognize
+  virtual ocr_confidence_t confidence() const = 0;
+  /// Name and version, part of the OCR cache settings
+  virtual std::string version() const = 0;
+
+ protected:
+  ocr_engine() {}
+
+ private:
+  // noncopyable
+  ocr_engine(ocr_engine const &);
+  ocr_engine &operator=(ocr_engine const &);
+};
+
+#endif
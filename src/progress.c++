@@ -0,0 +1,182 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "progress.h++"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+// weight of the newest rate in the moving average
+double const rate_weight = 0.3;
+
+// write() that fails with EPIPE instead of raising the SIGPIPE that would kill
+// the conversion when the reader is gone. Sockets take MSG_NOSIGNAL, for
+// anything else the signal is blocked in this thread during the write and
+// discarded if the write raised it.
+ssize_t write_nosignal(int fd, void const *data, size_t size) {
+#ifdef MSG_NOSIGNAL
+  ssize_t const sent = send(fd, data, size, MSG_NOSIGNAL);
+  if (sent >= 0 or errno != ENOTSOCK) return sent;
+#endif
+  sigset_t pipe_set, old_set, pending;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+  sigpending(&pending);
+  bool const was_pending = sigismember(&pending, SIGPIPE);
+  ssize_t const written = write(fd, data, size);
+  int const error = errno;
+  if (written < 0 and error == EPIPE and !was_pending) {
+    timespec const no_wait = {0, 0};
+    sigtimedwait(&pipe_set, NULL, &no_wait);
+  }
+  pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+  errno = error;
+  return written;
+}
+}  // namespace
+
+progress_reporter::progress_reporter()
+    : fd(-1),
+      total_packets(0),
+      interval(chrono::seconds(1)),
+      packets_read(0),
+      cues_decoded(0),
+      cues_done(0),
+      input_done(false),
+      last_done(0),
+      rate(0.0),
+      have_rate(false),
+      thread(NULL),
+      stopping(false) {}
+
+progress_reporter::~progress_reporter() { stop(); }
+
+bool progress_reporter::start(int fd, unsigned total_packets,
+                              clock::duration interval) {
+  if (fcntl(fd, F_GETFD) < 0) {
+    cerr << "Can't write progress to file descriptor " << fd << ": "
+         << strerror(errno) << '\n';
+    return false;
+  }
+  this->fd = fd;
+  this->total_packets = total_packets;
+  this->interval = interval;
+  start_time = last_time = clock::now();
+  write_event(false);
+  thread = new std::thread(&progress_reporter::run, this);
+  return true;
+}
+
+void progress_reporter::finish() {
+  if (thread == NULL) return;
+  stop();
+  write_event(true);
+  fd = -1;
+}
+
+void progress_reporter::stop() {
+  if (thread == NULL) return;
+  {
+    lock_guard<mutex> lock(mut);
+    stopping = true;
+  }
+  wake.notify_one();
+  thread->join();
+  delete thread;
+  thread = NULL;
+}
+
+void progress_reporter::run() {
+  unique_lock<mutex> lock(mut);
+  while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+    lock.unlock();
+    write_event(false);
+    lock.lock();
+  }
+}
+
+void progress_reporter::write_event(bool last) {
+  if (fd < 0) return;
+  clock::time_point const now = clock::now();
+  unsigned const read = packets_read, decoded = cues_decoded,
+                 done = cues_done;
+  double const dt = chrono::duration<double>(now - last_time).count();
+  // the average starts with the first finished subtitle, the time the OCR
+  // engines take to start would only drag it down
+  if (dt > 0 and done > 0) {
+    double const sample = (done - last_done) / dt;
+    rate = have_rate ? rate_weight * sample + (1 - rate_weight) * rate
+                     : sample;
+    have_rate = true;
+  }
+  last_time = now;
+  last_done = done;
+
+  // the subtitles per packet so far tell how many subtitles to expect
+  long long total = -1;
+  if (input_done or last)
+    total = decoded;
+  else if (total_packets > 0 and read > 0)
+    total = static_cast<long long>(decoded) * total_packets / read;
+  if (total >= 0 and total < decoded) total = decoded;
+
+  char packets_total[24] = "null", cues_total[24] = "null", eta[32] = "null";
+  if (total_packets > 0)
+    snprintf(packets_total, sizeof(packets_total), "%u", total_packets);
+  if (total >= 0) snprintf(cues_total, sizeof(cues_total), "%lld", total);
+  if (last)
+    snprintf(eta, sizeof(eta), "0");
+  else if (total >= 0 and rate > 0)
+    snprintf(eta, sizeof(eta), "%.1f",
+             total > done ? (total - done) / rate : 0.0);
+  char line[512];
+  int const n = snprintf(
+      line, sizeof(line),
+      "{\"elapsed_s\":%.3f,\"packets_total\":%s,\"packets_read\":%u,"
+      "\"cues_total\":%s,\"cues_decoded\":%u,\"cues_done\":%u,"
+      "\"cues_per_second\":%.2f,\"eta_s\":%s,\"done\":%s}\n",
+      chrono::duration<double>(now - start_time).count(), packets_total,
+      read, cues_total, decoded, done, rate, eta, last ? "true" : "false");
+  char const *p = line;
+  size_t size = n;
+  while (size > 0) {
+    ssize_t const written = write_nosignal(fd, p, size);
+    if (written < 0 and errno == EINTR) continue;
+    if (written <= 0) {
+      cerr << "WARNING: can't write progress: " << strerror(errno) << '\n';
+      fd = -1;  // the reader is gone, carry on without
+      return;
+    }
+    p += written;
+    size -= written;
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PROGRESS_HXX
+#define PROGRESS_HXX
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// Writes the progress of the conversion as one JSON object per line to a
+/// file descriptor (--progress-fd), for tools that run vobsub2srt as a job.
+/// The counters are atomic and cheap to bump from any thread. A thread of its
+/// own writes an event every interval, so the rate is bounded no matter how
+/// fast subtitles are converted. Nothing runs without start().
+struct progress_reporter {
+  typedef std::chrono::steady_clock clock;
+
+  progress_reporter();
+  ~progress_reporter();
+
+  /// Starts the events on fd. total_packets is the number of SPU packets of
+  /// the input, 0 if it is not known in advance. Prints an error if fd is
+  /// not open.
+  bool start(int fd, unsigned total_packets,
+             clock::duration interval = std::chrono::seconds(1));
+  /// Writes the last event (with "done":true) and stops. Without it, e.g.
+  /// after an error, the events just end.
+  void finish();
+
+  void packet_read() { packets_read.fetch_add(1, std::memory_order_relaxed); }
+  void decoded() { cues_decoded.fetch_add(1, std::memory_order_relaxed); }
+  /// A subtitle is finished: recognized, found in a cache or rejected
+  void done() { cues_done.fetch_add(1, std::memory_order_relaxed); }
+  /// All packets are read, the number of subtitles is known now
+  void input_finished() { input_done = true; }
+
+ private:
+  void run();
+  void stop();
+  void write_event(bool last);
+
+  int fd;
+  unsigned total_packets;
+  clock::duration interval;
+  clock::time_point start_time, last_time;
+  std::atomic<unsigned> packets_read, cues_decoded, cues_done;
+  std::atomic<bool> input_done;
+  // moving average of the finished subtitles per second for the ETA
+  unsigned last_done;
+  double rate;
+  bool have_rate;
+
+  std::thread *thread;
+  std::mutex mut;
+  std::condition_variable wake;
+  bool stopping;
+
+  // noncopyable
+  progress_reporter(progress_reporter const &);
+  progress_reporter &operator=(progress_reporter const &);
+};
+
+#endif
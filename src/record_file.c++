@@ -0,0 +1,54 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "record_file.h++"
+
+#include <unistd.h>
+
+#include <cerrno>
+
+uint64_t hash_bytes(void const *data, size_t size, uint64_t hash) {
+  unsigned char const *p = static_cast<unsigned char const *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= p[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint32_t record_check(unsigned char const *header, size_t header_size,
+                      char const *text, size_t size) {
+  return static_cast<uint32_t>(
+      hash_bytes(text, size, hash_bytes(header, header_size - 4)));
+}
+
+bool write_all(int fd, void const *data, size_t size) {
+  unsigned char const *p = static_cast<unsigned char const *>(data);
+  while (size > 0) {
+    ssize_t const n = write(fd, p, size);
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
@@ -0,0 +1,59 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef RECORD_FILE_HXX
+#define RECORD_FILE_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Helpers for the record files of ocr_cache and resume_journal. A record is
+// a header of fixed size ending in a 32 bit check, followed by its text.
+
+/// 64 bit FNV-1a hash, pass the result of an earlier call to continue it
+uint64_t hash_bytes(void const *data, size_t size,
+                    uint64_t hash = 0xcbf29ce484222325ULL);
+
+/// Stores a header field (in the byte order of the machine)
+template <typename T>
+void put(unsigned char *p, T value) {
+  memcpy(p, &value, sizeof(value));
+}
+
+/// Loads a header field
+template <typename T>
+T get(unsigned char const *p) {
+  T value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/// Check of a record: hash of the header without its last 4 bytes (where the
+/// check goes) and the text
+uint32_t record_check(unsigned char const *header, size_t header_size,
+                      char const *text, size_t size);
+
+/// write() until all of data is written, false on an error
+bool write_all(int fd, void const *data, size_t size);
+
+#endif
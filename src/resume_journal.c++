@@ -0,0 +1,189 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "resume_journal.h++"
+#include "record_file.h++"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+char const file_magic[8] = {'V', '2', 'S', 'J', 'R', 'N', '\0', '\1'};
+// file header: magic, settings hash
+enum { file_header_size = 16 };
+// record header: counter, start_pts, end_pts, flags, words, mean, min, text
+// length, check (hash of the header before it and the text)
+enum { header_size = 36 };
+enum { FLAG_TIMED_OUT = 1 };
+// journaled cues are synced to the disk at most this often
+chrono::seconds const sync_interval(1);
+}  // namespace
+
+resume_journal::resume_journal() : fd(-1) {}
+
+resume_journal::~resume_journal() { close(); }
+
+bool resume_journal::open(string const &filename, string const &settings) {
+  this->filename = filename;
+  fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    cerr << "Can't open journal " << filename << ": " << strerror(errno)
+         << '\n';
+    return false;
+  }
+  if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+    cerr << filename << " is used by another vobsub2srt\n";
+    close();
+    return false;
+  }
+  unsigned char header[file_header_size];
+  memcpy(header, file_magic, sizeof(file_magic));
+  put<uint64_t>(header + 8, hash_bytes(settings.data(), settings.size()));
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close();
+    return false;
+  }
+  if (st.st_size > 0) {
+    unsigned char old[file_header_size];
+    if (pread(fd, old, sizeof(old), 0) != sizeof(old) or
+        memcmp(old, file_magic, sizeof(file_magic)) != 0) {
+      cerr << filename << " is not a vobsub2srt journal\n";
+      close();
+      return false;
+    }
+    if (memcmp(old, header, sizeof(header)) == 0)
+      return read_entries(st.st_size);
+    cerr << "WARNING: " << filename
+         << " was written with other settings, starting over\n";
+    if (ftruncate(fd, 0) < 0) {
+      close();
+      return false;
+    }
+  }
+  if (!write_all(fd, header, sizeof(header))) {
+    cerr << "Can't write journal " << filename << '\n';
+    close();
+    return false;
+  }
+  last_sync = chrono::steady_clock::now();
+  return true;
+}
+
+bool resume_journal::read_entries(uint64_t size) {
+  vector<unsigned char> data(size - file_header_size);
+  if (pread(fd, data.data(), data.size(), file_header_size) !=
+      static_cast<ssize_t>(data.size())) {
+    cerr << "Can't read journal " << filename << '\n';
+    close();
+    return false;
+  }
+  size_t pos = 0;
+  while (data.size() - pos >= header_size) {
+    unsigned char const *header = &data[pos];
+    uint32_t const text_len = get<uint32_t>(header + 28);
+    if (text_len > data.size() - pos - header_size) break;
+    char const *text = reinterpret_cast<char const *>(header + header_size);
+    if (get<uint32_t>(header + 32) !=
+        record_check(header, header_size, text, text_len))
+      break;
+    journal_entry_t entry;
+    entry.counter = get<uint32_t>(header);
+    entry.start_pts = get<uint32_t>(header + 4);
+    entry.end_pts = get<uint32_t>(header + 8);
+    entry.timed_out = get<uint32_t>(header + 12) & FLAG_TIMED_OUT;
+    entry.words = get<uint32_t>(header + 16);
+    entry.mean = get<float>(header + 20);
+    entry.min = get<float>(header + 24);
+    entry.text.assign(text, text_len);
+    entries[entry.counter] = entry;
+    pos += header_size + text_len;
+  }
+  if (pos < data.size()) {
+    cerr << "WARNING: dropping " << data.size() - pos
+         << " broken bytes at the end of " << filename << '\n';
+    if (ftruncate(fd, file_header_size + pos) < 0) {
+      close();
+      return false;
+    }
+  }
+  last_sync = chrono::steady_clock::now();
+  return true;
+}
+
+journal_entry_t const *resume_journal::find(unsigned counter) const {
+  auto const i = entries.find(counter);
+  return i == entries.end() ? NULL : &i->second;
+}
+
+void resume_journal::add(journal_entry_t const &entry) {
+  vector<unsigned char> record(header_size + entry.text.size());
+  unsigned char *header = record.data();
+  put<uint32_t>(header, entry.counter);
+  put<uint32_t>(header + 4, entry.start_pts);
+  put<uint32_t>(header + 8, entry.end_pts);
+  put<uint32_t>(header + 12, entry.timed_out ? FLAG_TIMED_OUT : 0);
+  put<uint32_t>(header + 16, entry.words);
+  put<float>(header + 20, entry.mean);
+  put<float>(header + 24, entry.min);
+  put<uint32_t>(header + 28, entry.text.size());
+  memcpy(header + header_size, entry.text.data(), entry.text.size());
+  put<uint32_t>(header + 32,
+                record_check(header, header_size, entry.text.data(),
+                             entry.text.size()));
+
+  lock_guard<mutex> guard(mut);
+  if (fd < 0) return;
+  if (!write_all(fd, record.data(), record.size())) {
+    cerr << "WARNING: can't write journal " << filename << ": "
+         << strerror(errno) << '\n';
+    return;
+  }
+  // a preempted machine loses what is only in the page cache
+  chrono::steady_clock::time_point const now = chrono::steady_clock::now();
+  if (now - last_sync >= sync_interval) {
+    fdatasync(fd);
+    last_sync = now;
+  }
+}
+
+void resume_journal::finish() {
+  lock_guard<mutex> guard(mut);
+  if (fd < 0) return;
+  unlink(filename.c_str());
+  close();
+}
+
+void resume_journal::close() {
+  if (fd < 0) return;
+  ::close(fd);
+  fd = -1;
+}
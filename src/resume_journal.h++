@@ -0,0 +1,78 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESUME_JOURNAL_HXX
+#define RESUME_JOURNAL_HXX
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/// A finished cue as it goes into the .srt
+struct journal_entry_t {
+  unsigned counter, start_pts, end_pts;
+  std::string text;
+  unsigned words;
+  float mean, min;  ///< word confidences
+  bool timed_out;
+};
+
+/// Log of the finished cues of a conversion (--resume). Every cue is appended
+/// as soon as its OCR is done, so a killed run only loses the images that
+/// were in flight. A restarted run with the same input and settings takes the
+/// journaled cues instead of recognizing them again. A broken record at the
+/// end (from a killed process) is dropped.
+struct resume_journal {
+  resume_journal();
+  ~resume_journal();
+
+  /// Opens or creates the journal. The cues of an existing journal are only
+  /// used if it was written with the same settings, otherwise it starts over.
+  /// Prints an error on failure.
+  bool open(std::string const &filename, std::string const &settings);
+  /// The journaled cue with this counter or NULL
+  journal_entry_t const *find(unsigned counter) const;
+  /// Appends a finished cue. Thread safe.
+  void add(journal_entry_t const &entry);
+  /// Closes and removes the journal after the output has been written
+  void finish();
+  bool is_open() const { return fd >= 0; }
+  /// Number of cues taken from an earlier run
+  size_t resumed() const { return entries.size(); }
+
+ private:
+  bool read_entries(uint64_t size);
+  void close();
+
+  std::mutex mut;
+  int fd;
+  std::string filename;
+  std::chrono::steady_clock::time_point last_sync;
+  std::unordered_map<unsigned, journal_entry_t> entries;  // by counter
+
+  // noncopyable
+  resume_journal(resume_journal const &);
+  resume_journal &operator=(resume_journal const &);
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "stats.h++"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+char const *const stage_names[STAGE_COUNT] = {
+    "open", "read", "decode", "prepare", "init", "wait", "ocr", "write"};
+char const *const memory_names[MEMORY_COUNT] = {
+    "packets", "decoder", "prepare", "jobs", "engines", "text"};
+
+double to_seconds(conversion_stats::clock::duration d) {
+  return chrono::duration<double>(d).count();
+}
+
+double to_mib(uint64_t bytes) { return bytes / (1024.0 * 1024.0); }
+}  // namespace
+
+conversion_stats::conversion_stats()
+    : subtitles(0),
+      peak_pending(0),
+      peak_dump(0),
+      peak_resident(0),
+      stage(STAGE_OPEN),
+      running(false) {
+  fill(stages, stages + STAGE_COUNT, clock::duration::zero());
+}
+
+stats_stage_t conversion_stats::enter(stats_stage_t next) {
+  clock::time_point const now = clock::now();
+  if (running)
+    stages[stage] += now - last;
+  else
+    start = now;
+  running = true;
+  last = now;
+  stats_stage_t const previous = stage;
+  stage = next;
+  return previous;
+}
+
+void conversion_stats::finish() {
+  if (running) stages[stage] += clock::now() - last;
+  running = false;
+  sort(latencies.begin(), latencies.end());
+  peak_resident = peak_resident_bytes();
+}
+
+void conversion_stats::add_worker(unsigned images, clock::duration busy,
+                                  clock::duration lifetime,
+                                  vector<float> const &times) {
+  worker_t const worker = {images, to_seconds(busy),
+                           max(0.0, to_seconds(lifetime - busy))};
+  workers.push_back(worker);
+  latencies.insert(latencies.end(), times.begin(), times.end());
+}
+
+double conversion_stats::seconds(stats_stage_t s) const {
+  return to_seconds(stages[s]);
+}
+
+double conversion_stats::wall() const {
+  double sum = 0.0;
+  for (int s = 0; s < STAGE_COUNT; ++s)
+    sum += seconds(static_cast<stats_stage_t>(s));
+  return sum;
+}
+
+// nearest rank
+float conversion_stats::percentile(double p) const {
+  if (latencies.empty()) return 0.0f;
+  size_t rank = static_cast<size_t>(ceil(p / 100.0 * latencies.size()));
+  if (rank > 0) --rank;
+  return latencies[min(rank, latencies.size() - 1)];
+}
+
+string conversion_stats::report() const {
+  ostringstream os;
+  double const total = wall();
+  os << fixed << setprecision(3) << "Main thread:\n";
+  for (int s = 0; s < STAGE_COUNT; ++s) {
+    double const t = seconds(static_cast<stats_stage_t>(s));
+    os << "  " << setw(8) << left << stage_names[s] << right << setw(10) << t
+       << " s " << setw(6) << setprecision(1)
+       << (total > 0 ? t * 100 / total : 0.0) << "%\n"
+       << setprecision(3);
+  }
+  os << "  " << setw(8) << left << "total" << right << setw(10) << total
+     << " s\n";
+  if (!workers.empty()) {
+    os << "OCR threads:\n";
+    for (size_t i = 0; i < workers.size(); ++i) {
+      os << "  #" << setw(3) << left << i << right << setw(6)
+         << workers[i].images << " images, busy " << workers[i].busy
+         << " s, idle " << workers[i].idle << " s\n";
+    }
+  }
+  if (!latencies.empty()) {
+    os << setprecision(1) << "OCR latency: p50 " << percentile(50)
+       << " ms, p95 " << percentile(95) << " ms, p99 " << percentile(99)
+       << " ms, max " << latencies.back() << " ms\n";
+  }
+  os << "Peak queues: " << peak_pending << " images for OCR, " << peak_dump
+     << " images to dump\n"
+     << "Throughput: " << subtitles << " subtitles, " << setprecision(2)
+     << (total > 0 ? subtitles / total : 0.0) << " per second\n";
+  os << "Memory (MiB):     now     peak  allocations\n";
+  for (int m = 0; m < MEMORY_COUNT; ++m) {
+    os << "  " << setw(8) << left << memory_names[m] << right << setw(11)
+       << to_mib(memory[m].bytes) << setw(9) << to_mib(memory[m].peak)
+       << setw(13) << memory[m].allocations.load() << '\n';
+  }
+  os << "  " << setw(8) << left << "resident" << right << setw(20)
+     << to_mib(peak_resident) << '\n';
+  return os.str();
+}
+
+bool conversion_stats::write_json(string const &filename) const {
+  ostringstream os;
+  double const total = wall();
+  os << setprecision(6) << "{\"wall\":" << total << ",\"subtitles\":"
+     << subtitles << ",\"subtitles_per_second\":"
+     << (total > 0 ? subtitles / total : 0.0) << ",\"stages\":{";
+  for (int s = 0; s < STAGE_COUNT; ++s) {
+    os << (s ? "," : "") << '"' << stage_names[s]
+       << "\":" << seconds(static_cast<stats_stage_t>(s));
+  }
+  os << "},\"workers\":[";
+  for (size_t i = 0; i < workers.size(); ++i) {
+    os << (i ? "," : "") << "{\"images\":" << workers[i].images
+       << ",\"busy\":" << workers[i].busy << ",\"idle\":" << workers[i].idle
+       << '}';
+  }
+  os << "],\"ocr_latency_ms\":{\"count\":" << latencies.size()
+     << ",\"p50\":" << percentile(50) << ",\"p95\":" << percentile(95)
+     << ",\"p99\":" << percentile(99)
+     << ",\"max\":" << (latencies.empty() ? 0.0f : latencies.back())
+     << "},\"peak_queue\":{\"ocr\":" << peak_pending
+     << ",\"dump\":" << peak_dump << "},\"memory\":{";
+  for (int m = 0; m < MEMORY_COUNT; ++m) {
+    os << (m ? "," : "") << '"' << memory_names[m]
+       << "\":{\"bytes\":" << memory[m].bytes.load()
+       << ",\"peak\":" << memory[m].peak.load()
+       << ",\"allocations\":" << memory[m].allocations.load() << '}';
+  }
+  os << ",\"peak_resident\":" << peak_resident << "}}\n";
+  string const json = os.str();
+  FILE *f = fopen(filename.c_str(), "w");
+  bool ok = f != NULL and fwrite(json.data(), json.size(), 1, f) == 1;
+  if (f != NULL and fclose(f) != 0) ok = false;
+  if (!ok) {
+    cerr << "Can't write " << filename << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,108 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STATS_HXX
+#define STATS_HXX
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "memory.h++"
+
+/// Steps of the main thread timed for --stats
+enum stats_stage_t {
+  STAGE_OPEN,     ///< opening the input and the caches (e.g. the MPEG scan)
+  STAGE_READ,     ///< reading the next packet
+  STAGE_DECODE,   ///< assembling and decoding the SPU packets
+  STAGE_PREPARE,  ///< inverting, scaling, dumping and the OCR cache lookup
+  STAGE_INIT,     ///< starting the OCR engines
+  STAGE_WAIT,     ///< waiting for a free OCR thread
+  STAGE_OCR,      ///< recognizing images itself (only with one thread)
+  STAGE_WRITE,    ///< sorting and writing the subtitles
+  STAGE_COUNT
+};
+
+/// Memory accounted for in --stats
+enum stats_memory_t {
+  MEMORY_PACKETS,  ///< packets read from the .sub file (vobsub)
+  MEMORY_DECODER,  ///< SPU packets and images of spudec
+  MEMORY_PREPARE,  ///< inverted and scaled images
+  MEMORY_JOBS,     ///< images waiting for and in OCR
+  MEMORY_ENGINES,  ///< resident memory the OCR engines added
+  MEMORY_TEXT,     ///< recognized text of the subtitles
+  MEMORY_COUNT
+};
+
+/// Where the time of a conversion went (--stats and --stats-json). All times
+/// come from the monotonic clock. The main thread moves from stage to stage
+/// with enter(), so its time is accounted for completely. The OCR threads
+/// keep their own numbers, which are added with add_worker() at the end.
+struct conversion_stats {
+  typedef std::chrono::steady_clock clock;
+
+  conversion_stats();
+
+  /// Charges the time since the last call to the current stage and continues
+  /// with stage. Returns the stage before, e.g. to return to it.
+  stats_stage_t enter(stats_stage_t stage);
+  /// Stops the clock after the last stage and notes the peak resident size
+  void finish();
+  /// Adds an OCR thread. latencies are the OCR times of its images in ms.
+  void add_worker(unsigned images, clock::duration busy,
+                  clock::duration lifetime,
+                  std::vector<float> const &latencies);
+  void queue_depth(size_t pending) {
+    if (pending > peak_pending) peak_pending = pending;
+  }
+
+  /// The summary table of --stats
+  std::string report() const;
+  /// Writes the numbers as a JSON object to filename. Prints an error on
+  /// failure.
+  bool write_json(std::string const &filename) const;
+
+  unsigned subtitles;   ///< number of converted subtitles
+  size_t peak_pending;  ///< images waiting for an OCR thread
+  size_t peak_dump;     ///< images waiting to be dumped
+  memory_counter memory[MEMORY_COUNT];
+  uint64_t peak_resident;  ///< of the process in bytes
+
+ private:
+  struct worker_t {
+    unsigned images;
+    double busy, idle;  // seconds
+  };
+
+  double seconds(stats_stage_t stage) const;
+  double wall() const;
+  float percentile(double p) const;
+
+  stats_stage_t stage;
+  bool running;
+  clock::time_point start, last;
+  clock::duration stages[STAGE_COUNT];
+  std::vector<worker_t> workers;
+  std::vector<float> latencies;  // sorted by finish()
+};
+
+#endif
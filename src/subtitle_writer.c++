@@ -0,0 +1,335 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "subtitle_writer.h++"
+#include "trace.h++"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+// the buffer is written once it holds this much
+enum { flush_size = 1 << 20 };
+
+struct srt_writer : subtitle_writer {
+  void write(subtitle_cue_t const &cue) {
+    append(cue.counter);
+    append('\n');
+    append_time(cue.start_pts, 2, ',', 3);
+    append(" --> ");
+    append_time(cue.end_pts, 2, ',', 3);
+    append('\n');
+    append(cue.text);
+    append("\n\n");
+    cue_done();
+  }
+};
+
+struct vtt_writer : subtitle_writer {
+  void begin(unsigned, unsigned) { append("WEBVTT\n\n"); }
+
+  void write(subtitle_cue_t const &cue) {
+    append(cue.counter);
+    append('\n');
+    append_time(cue.start_pts, 2, '.', 3);
+    append(" --> ");
+    append_time(cue.end_pts, 2, '.', 3);
+    append('\n');
+    // an empty line would end the cue
+    bool line_start = true;
+    for (char const *p = cue.text; *p; ++p) {
+      switch (*p) {
+        case '\n':
+          if (!line_start) append('\n');
+          line_start = true;
+          continue;
+        case '&':
+          append("&amp;");
+          break;
+        case '<':
+          append("&lt;");
+          break;
+        case '>':
+          append("&gt;");
+          break;
+        default:
+          append(*p);
+      }
+      line_start = false;
+    }
+    append(line_start ? "\n" : "\n\n");
+    cue_done();
+  }
+};
+
+struct ass_writer : subtitle_writer {
+  ass_writer() : frame_width(0), frame_height(0) {}
+
+  void begin(unsigned frame_width, unsigned frame_height) {
+    this->frame_width = frame_width;
+    this->frame_height = frame_height;
+    append("[Script Info]\nScriptType: v4.00+\n");
+    // without the frame size the images can't be positioned
+    if (frame_width > 0 and frame_height > 0) {
+      append("PlayResX: ");
+      append(frame_width);
+      append("\nPlayResY: ");
+      append(frame_height);
+      append('\n');
+    }
+    append(
+        "WrapStyle: 2\nScaledBorderAndShadow: yes\n\n"
+        "[V4+ Styles]\nFormat: Name, Fontname, Fontsize, PrimaryColour, "
+        "SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, "
+        "StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, "
+        "Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+        "Style: Default,Arial,");
+    append(frame_height > 0 ? frame_height / 18 : 20u);
+    append(
+        ",&H00FFFFFF,&H000000FF,&H00000000,&H80000000,0,0,0,0,100,100,0,0,1,"
+        "2,1,2,10,10,");
+    append(frame_height > 0 ? frame_height / 24 : 10u);
+    append(
+        ",1\n\n[Events]\nFormat: Layer, Start, End, Style, Name, MarginL, "
+        "MarginR, MarginV, Effect, Text\n");
+  }
+
+  void write(subtitle_cue_t const &cue) {
+    append("Dialogue: 0,");
+    append_time(cue.start_pts, 1, '.', 2);
+    append(',');
+    append_time(cue.end_pts, 1, '.', 2);
+    append(",Default,,0,0,0,,");
+    // bottom center of the subtitle image, where the DVD player showed it
+    if (frame_width > 0 and frame_height > 0 and cue.position.width > 0) {
+      append("{\\an2\\pos(");
+      append(cue.position.x + cue.position.width / 2);
+      append(',');
+      append(cue.position.y + cue.position.height);
+      append(")}");
+    }
+    bool line_start = true;
+    for (char const *p = cue.text; *p; ++p) {
+      if (*p == '\n') {
+        if (!line_start) append("\\N");
+        line_start = true;
+      } else {
+        append(*p);
+        line_start = false;
+      }
+    }
+    append('\n');
+    cue_done();
+  }
+
+  unsigned frame_width, frame_height;
+};
+
+struct ndjson_writer : subtitle_writer {
+  void write(subtitle_cue_t const &cue) {
+    append("{\"index\":");
+    append(cue.counter);
+    append(",\"start_ms\":");
+    append(cue.start_pts / 90);
+    append(",\"end_ms\":");
+    append(cue.end_pts / 90);
+    append(",\"text\":\"");
+    for (unsigned char const *p =
+             reinterpret_cast<unsigned char const *>(cue.text);
+         *p; ++p) {
+      switch (*p) {
+        case '"':
+          append("\\\"");
+          break;
+        case '\\':
+          append("\\\\");
+          break;
+        case '\n':
+          append("\\n");
+          break;
+        case '\t':
+          append("\\t");
+          break;
+        default:
+          if (*p < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", *p);
+            append(buf);
+          } else {
+            append(static_cast<char>(*p));
+          }
+      }
+    }
+    append("\",\"x\":");
+    append(cue.position.x);
+    append(",\"y\":");
+    append(cue.position.y);
+    append(",\"width\":");
+    append(cue.position.width);
+    append(",\"height\":");
+    append(cue.position.height);
+    append(",\"words\":");
+    append(cue.words);
+    char buf[64];
+    snprintf(buf, sizeof(buf),
+             ",\"confidence\":%.1f,\"min_confidence\":%.1f}\n", cue.mean,
+             cue.min);
+    append(buf);
+    cue_done();
+  }
+};
+}  // namespace
+
+bool parse_subtitle_format(string const &name, subtitle_format_t *format) {
+  if (name == "srt")
+    *format = FORMAT_SRT;
+  else if (name == "vtt")
+    *format = FORMAT_VTT;
+  else if (name == "ass")
+    *format = FORMAT_ASS;
+  else if (name == "ndjson")
+    *format = FORMAT_NDJSON;
+  else
+    return false;
+  return true;
+}
+
+char const *subtitle_extension(subtitle_format_t format) {
+  switch (format) {
+    case FORMAT_VTT:
+      return "vtt";
+    case FORMAT_ASS:
+      return "ass";
+    case FORMAT_NDJSON:
+      return "ndjson";
+    case FORMAT_SRT:
+      break;
+  }
+  return "srt";
+}
+
+subtitle_writer *subtitle_writer::create(subtitle_format_t format) {
+  switch (format) {
+    case FORMAT_VTT:
+      return new vtt_writer;
+    case FORMAT_ASS:
+      return new ass_writer;
+    case FORMAT_NDJSON:
+      return new ndjson_writer;
+    case FORMAT_SRT:
+      break;
+  }
+  return new srt_writer;
+}
+
+subtitle_writer::subtitle_writer() : fd(-1), failed(false) {
+  buffer.reserve(flush_size + 4096);
+}
+
+subtitle_writer::~subtitle_writer() { close(); }
+
+bool subtitle_writer::open(string const &filename) {
+  if (filename == "-") {
+    // keep all other output (including the mplayer messages) out of the
+    // subtitles
+    fd = dup(STDOUT_FILENO);
+    if (fd >= 0) dup2(STDERR_FILENO, STDOUT_FILENO);
+  } else {
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd < 0) {
+    cerr << "could not open " << filename << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  return true;
+}
+
+void subtitle_writer::begin(unsigned, unsigned) {}
+
+bool subtitle_writer::close() {
+  if (fd < 0) return !failed;
+  flush();
+  if (::close(fd) < 0) failed = true;
+  fd = -1;
+  return !failed;
+}
+
+void subtitle_writer::append(unsigned value) {
+  char digits[10];
+  char *p = digits + sizeof(digits);
+  do {
+    *--p = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  buffer.append(p, digits + sizeof(digits));
+}
+
+void subtitle_writer::append_time(unsigned pts, unsigned hour_digits,
+                                  char separator, unsigned fraction_digits) {
+  unsigned const ms = pts / 90;
+  unsigned const h = ms / (3600 * 1000);
+  unsigned const m = ms / (60 * 1000) % 60;
+  unsigned const s = ms / 1000 % 60;
+  unsigned const frac = ms % 1000;
+  if (hour_digits > 1 and h < 10) append('0');
+  append(h);
+  char buf[10] = {':',
+                  char('0' + m / 10),
+                  char('0' + m % 10),
+                  ':',
+                  char('0' + s / 10),
+                  char('0' + s % 10),
+                  separator,
+                  char('0' + frac / 100),
+                  char('0' + frac / 10 % 10),
+                  char('0' + frac % 10)};
+  buffer.append(buf, fraction_digits == 2 ? 9 : 10);
+}
+
+void subtitle_writer::cue_done() {
+  if (buffer.size() >= flush_size) flush();
+}
+
+bool subtitle_writer::flush() {
+  trace_span span("flush");
+  char const *p = buffer.data();
+  size_t size = buffer.size();
+  while (size > 0 and !failed) {
+    ssize_t const n = ::write(fd, p, size);
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) {
+      perror("could not write subtitles");
+      failed = true;
+      break;
+    }
+    p += n;
+    size -= n;
+  }
+  buffer.clear();
+  return !failed;
+}
@@ -0,0 +1,91 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SUBTITLE_WRITER_HXX
+#define SUBTITLE_WRITER_HXX
+
+#include <string>
+
+/// Output formats of --format
+enum subtitle_format_t { FORMAT_SRT, FORMAT_VTT, FORMAT_ASS, FORMAT_NDJSON };
+
+/// Parses a --format name ("srt", "vtt", "ass" or "ndjson")
+bool parse_subtitle_format(std::string const &name, subtitle_format_t *format);
+
+/// File name extension (without the dot) of the format
+char const *subtitle_extension(subtitle_format_t format);
+
+/// Position of the subtitle image in the video frame
+struct cue_position_t {
+  unsigned x, y, width, height;
+};
+
+/// One subtitle as it is written
+struct subtitle_cue_t {
+  unsigned counter;
+  unsigned start_pts, end_pts;  ///< 90 kHz
+  char const *text;             ///< never NULL, empty if the OCR failed
+  cue_position_t position;
+  unsigned words;   ///< number of recognized words
+  float mean, min;  ///< word confidences (0-100)
+};
+
+/// Writes subtitles into one large buffer that is flushed in big writes.
+/// The formats derive from it and append the cues with the append helpers.
+struct subtitle_writer {
+  /// Creates the writer for the format
+  static subtitle_writer *create(subtitle_format_t format);
+  virtual ~subtitle_writer();
+
+  /// Opens the output file, "-" is stdout. Prints an error on failure.
+  bool open(std::string const &filename);
+  /// Writes the header. The frame size is 0 if it is unknown.
+  virtual void begin(unsigned frame_width, unsigned frame_height);
+  virtual void write(subtitle_cue_t const &cue) = 0;
+  /// Flushes the buffer and closes the file. Returns false on write errors.
+  bool close();
+
+ protected:
+  subtitle_writer();
+
+  void append(char c) { buffer += c; }
+  void append(char const *str) { buffer += str; }
+  void append(unsigned value);
+  /// H:MM:SS with at least hour_digits hours, followed by separator and
+  /// fraction_digits (2 or 3) digits of the second
+  void append_time(unsigned pts, unsigned hour_digits, char separator,
+                   unsigned fraction_digits);
+  /// Makes room in the buffer if needed, called after each cue
+  void cue_done();
+
+ private:
+  bool flush();
+
+  std::string buffer;
+  int fd;
+  bool failed;
+
+  // noncopyable
+  subtitle_writer(subtitle_writer const &);
+  subtitle_writer &operator=(subtitle_writer const &);
+};
+
+#endif
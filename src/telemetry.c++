@@ -0,0 +1,86 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "telemetry.h++"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+char const *const source_names[] = {"ocr", "cache", "journal", "rejected"};
+}  // namespace
+
+telemetry_log::telemetry_log() : file(NULL) {}
+
+telemetry_log::~telemetry_log() { close(); }
+
+bool telemetry_log::open(string const &filename) {
+  this->filename = filename;
+  file = fopen(filename.c_str(), "w");
+  if (file == NULL) {
+    cerr << "could not open " << filename << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  return true;
+}
+
+void telemetry_log::add(telemetry_record_t const &r) {
+  char end_ms[16] = "null";
+  if (r.end_pts != UINT_MAX)
+    snprintf(end_ms, sizeof(end_ms), "%u", r.end_pts / 90);
+  char line[512];
+  int n = snprintf(
+      line, sizeof(line),
+      "{\"index\":%u,\"start_ms\":%u,\"end_ms\":%s,\"x\":%u,\"y\":%u,"
+      "\"width\":%u,\"height\":%u,\"ocr_width\":%u,\"ocr_height\":%u,"
+      "\"ink\":%u,\"source\":\"%s\"",
+      r.counter, r.start_pts / 90, end_ms, r.position.x, r.position.y,
+      r.position.width, r.position.height, r.width, r.height, r.ink,
+      source_names[r.source]);
+  if (r.reason)
+    n += snprintf(line + n, sizeof(line) - n, ",\"reason\":\"%s\"", r.reason);
+  if (r.cache >= 0)
+    n += snprintf(line + n, sizeof(line) - n, ",\"cache\":\"%s\"",
+                  r.cache ? "hit" : "miss");
+  if (r.source == SOURCE_OCR)
+    n += snprintf(line + n, sizeof(line) - n,
+                  ",\"worker\":%d,\"queue_wait_ms\":%.3f,\"ocr_ms\":%.3f",
+                  r.worker, r.queue_wait_ms, r.ocr_ms);
+  snprintf(line + n, sizeof(line) - n,
+           ",\"words\":%u,\"confidence\":%.1f,\"timed_out\":%s}\n", r.words,
+           r.mean, r.timed_out ? "true" : "false");
+  lock_guard<mutex> guard(mut);
+  if (file) fputs(line, file);
+}
+
+bool telemetry_log::close() {
+  lock_guard<mutex> guard(mut);
+  if (file == NULL) return true;
+  bool ok = !ferror(file);
+  if (fclose(file) != 0) ok = false;
+  file = NULL;
+  if (!ok) cerr << "could not write " << filename << '\n';
+  return ok;
+}
@@ -0,0 +1,81 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TELEMETRY_HXX
+#define TELEMETRY_HXX
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include "subtitle_writer.h++"
+
+/// Where the text of a subtitle image came from
+enum telemetry_source_t {
+  SOURCE_OCR,      ///< recognized by an OCR thread
+  SOURCE_CACHE,    ///< found in the --ocr-cache
+  SOURCE_JOURNAL,  ///< taken from the --resume journal
+  SOURCE_REJECTED  ///< dropped before the OCR, see reason
+};
+
+/// One subtitle image of the --telemetry sidecar
+struct telemetry_record_t {
+  unsigned counter = 0;
+  unsigned start_pts = 0, end_pts = 0;  ///< 90 kHz, end_pts may be UINT_MAX
+  cue_position_t position = {0, 0, 0, 0};  ///< cropped image in the frame
+  unsigned width = 0, height = 0;  ///< of the OCR input (after scaling)
+  unsigned ink = 0;                ///< dark pixels of the OCR input
+  telemetry_source_t source = SOURCE_OCR;
+  char const *reason = NULL;  ///< why it was rejected
+  int cache = -1;             ///< 1 hit, 0 miss, -1 no --ocr-cache
+  int worker = -1;            ///< OCR thread or -1
+  double queue_wait_ms = 0.0;  ///< from decoding until an OCR thread took it
+  double ocr_ms = 0.0;
+  unsigned words = 0;
+  float mean = 0.0f;  ///< word confidence
+  bool timed_out = false;
+};
+
+/// Writes one JSON object per subtitle image (--telemetry). The records are
+/// written in the order the images are done, not sorted by counter.
+struct telemetry_log {
+  telemetry_log();
+  ~telemetry_log();
+
+  /// Prints an error on failure
+  bool open(std::string const &filename);
+  /// Thread safe
+  void add(telemetry_record_t const &record);
+  /// Returns false on write errors
+  bool close();
+  bool is_open() const { return file != NULL; }
+
+ private:
+  std::mutex mut;
+  FILE *file;
+  std::string filename;
+
+  // noncopyable
+  telemetry_log(telemetry_log const &);
+  telemetry_log &operator=(telemetry_log const &);
+};
+
+#endif
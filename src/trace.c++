@@ -0,0 +1,139 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "trace.h++"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+bool trace_enabled = false;
+
+namespace {
+struct event_t {
+  char const *name;
+  unsigned row;
+  long arg;
+  chrono::steady_clock::time_point start, end;
+};
+
+struct buffer_t {
+  unsigned row;
+  vector<event_t> events;
+};
+
+mutex registry_mut;
+vector<buffer_t *> buffers;  // of all threads, freed by trace_finish
+map<string, unsigned> rows;  // by thread name
+chrono::steady_clock::time_point epoch;
+
+// The threads that trace (main, OCR, image dump) live until the end of the
+// conversion, so every thread keeps its own buffer
+thread_local buffer_t *local = NULL;
+
+buffer_t *local_buffer() {
+  if (local == NULL) {
+    lock_guard<mutex> guard(registry_mut);
+    buffers.push_back(new buffer_t);
+    buffers.back()->row = 0;
+    buffers.back()->events.reserve(1024);
+    local = buffers.back();
+  }
+  return local;
+}
+
+double microseconds(chrono::steady_clock::duration d) {
+  return chrono::duration<double, micro>(d).count();
+}
+}  // namespace
+
+void trace_start() {
+  epoch = chrono::steady_clock::now();
+  rows["main"] = 0;
+  trace_enabled = true;
+}
+
+void trace_thread(char const *name, int number) {
+  if (!trace_enabled) return;
+  string row_name = name;
+  if (number >= 0) row_name += ' ' + to_string(number);
+  buffer_t *const buffer = local_buffer();
+  lock_guard<mutex> guard(registry_mut);
+  map<string, unsigned>::iterator i = rows.find(row_name);
+  if (i == rows.end())
+    i = rows.insert(make_pair(row_name, unsigned(rows.size()))).first;
+  buffer->row = i->second;
+}
+
+void trace_span::record() {
+  buffer_t *const buffer = local_buffer();
+  event_t const event = {name, buffer->row, arg, start,
+                         chrono::steady_clock::now()};
+  buffer->events.push_back(event);
+}
+
+bool trace_finish(string const &filename) {
+  if (!trace_enabled) return true;
+  trace_enabled = false;
+  lock_guard<mutex> guard(registry_mut);
+  FILE *f = fopen(filename.c_str(), "w");
+  if (f == NULL) {
+    cerr << "could not open " << filename << ": " << strerror(errno) << '\n';
+    return false;
+  }
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+  char const *separator = "\n";
+  for (map<string, unsigned>::const_iterator i = rows.begin(); i != rows.end();
+       ++i) {
+    fprintf(f,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"%s\"}}",
+            separator, i->second, i->first.c_str());
+    separator = ",\n";
+  }
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    vector<event_t> const &events = buffers[b]->events;
+    for (size_t i = 0; i < events.size(); ++i) {
+      event_t const &e = events[i];
+      fprintf(f,
+              "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+              "\"ts\":%.3f,\"dur\":%.3f",
+              separator, e.name, e.row, microseconds(e.start - epoch),
+              microseconds(e.end - e.start));
+      if (e.arg >= 0) fprintf(f, ",\"args\":{\"index\":%ld}", e.arg);
+      fputc('}', f);
+    }
+    delete buffers[b];
+  }
+  buffers.clear();
+  local = NULL;
+  fputs("\n]}\n", f);
+  bool ok = !ferror(f);
+  if (fclose(f) != 0) ok = false;
+  if (!ok) cerr << "could not write " << filename << '\n';
+  return ok;
+}
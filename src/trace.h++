@@ -0,0 +1,69 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRACE_HXX
+#define TRACE_HXX
+
+#include <chrono>
+#include <string>
+
+/// Set by trace_start. Only changes before any thread is started.
+extern bool trace_enabled;
+
+/// Starts recording spans for --trace
+void trace_start();
+/// Names the timeline row of the current thread, e.g. ("OCR thread", 2).
+/// Threads with the same name share a row.
+void trace_thread(char const *name, int number = -1);
+/// Writes the spans of all threads as Chrome trace events (JSON, for
+/// chrome://tracing or Perfetto). All threads that recorded spans must be
+/// done. Prints an error on failure.
+bool trace_finish(std::string const &filename);
+
+/// Records a span on the current thread from its construction to end() or
+/// its destruction. name must be a string literal. Does nothing unless
+/// tracing is on. The events go into a buffer of the thread, so the
+/// threads don't contend with each other.
+struct trace_span {
+  explicit trace_span(char const *name, long arg = -1)
+      : name(name), arg(arg), running(trace_enabled) {
+    if (running) start = std::chrono::steady_clock::now();
+  }
+  ~trace_span() { end(); }
+  void end() {
+    if (running) record();
+    running = false;
+  }
+
+ private:
+  void record();
+
+  char const *name;
+  long arg;  // shown as the index of the subtitle, -1: none
+  bool running;
+  std::chrono::steady_clock::time_point start;
+
+  // noncopyable
+  trace_span(trace_span const &);
+  trace_span &operator=(trace_span const &);
+};
+
+#endif
@@ -20,9 +20,16 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <climits>
@@ -30,175 +37,459 @@
 
 // VobSub2SRT
 #include "cmd_options.h++"
+#include "corpus.h++"
+#include "dvd_input.h++"
+#include "image_dump.h++"
+#include "image_prep.h++"
 #include "langcodes.h++"
+#include "matroska.h++"
+#include "ocr_cache.h++"
+#include "resume_journal.h++"
+#include "memory.h++"
+#include "ocr_engine.h++"
+#include "progress.h++"
+#include "stats.h++"
+#include "subtitle_writer.h++"
+#include "telemetry.h++"
+#include "trace.h++"
 
 // MPlayer
 #include "mp_msg.h"
 #include "spudec.h"
+#include "unrar_exec.h"
 #include "vobsub.h"
 
-// Tesseract
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-#include "tesseract/baseapi.h"
-
 using namespace std;
 
 typedef void *vob_t;
 typedef void *spu_t;
 
-struct ImageInverter {
-  ImageInverter(const unsigned char *image, size_t image_size)
-      : inverted_image(new unsigned char[image_size]) {
-    for (size_t i = 0; i < image_size; ++i)
-      inverted_image[i] = ((255 - image[i]) > 0x80) ? 0xff : 0;
-  }
-  ~ImageInverter() { delete[] inverted_image; }
-
-  unsigned char *inverted_image;
-};
-
 // helper struct for caching and fixing end_pts in some cases
 struct sub_text_t {
   sub_text_t(unsigned counter, unsigned start_pts, unsigned end_pts,
-             char const *text)
-      : counter(counter), start_pts(start_pts), end_pts(end_pts), text(text) {}
+             cue_position_t const &position, char const *text,
+             ocr_confidence_t const &confidence, bool timed_out = false)
+      : counter(counter),
+        start_pts(start_pts),
+        end_pts(end_pts),
+        position(position),
+        text(text),
+        confidence(confidence),
+        timed_out(timed_out) {}
   unsigned counter, start_pts, end_pts;
+  cue_position_t position;
   char const *text;
+  ocr_confidence_t confidence;
+  bool timed_out;  // OCR hit --ocr-timeout at least once
 };
 
-/** Converts time stamp in pts format to a string containing the time stamp for
- * the srt format
- *
- * pts (presentation time stamp) is given with a 90kHz resolution (1/90 ms).
- * srt expects a time stamp as HH:MM:SS,MSS.
- */
-std::string pts2srt(unsigned pts) {
-  unsigned ms = pts / 90;
-  unsigned const h = ms / (3600 * 1000);
-  ms -= h * 3600 * 1000;
-  unsigned const m = ms / (60 * 1000);
-  ms -= m * 60 * 1000;
-  unsigned const s = ms / 1000;
-  ms %= 1000;
-
-  enum { length = 4 * sizeof(h) };
-  char buf[length];
-  snprintf(buf, length, "%02d:%02d:%02d,%03d", h, m, s, ms);
-  return std::string(buf);
-}
-
-/// Dumps the image data to <subtitlename>-<subtitleid>.pgm in Netbpm PGM format
-void dump_pgm(std::string const &filename, unsigned counter, unsigned width,
-              unsigned height, unsigned stride, unsigned char const *image,
-              size_t image_size) {
-  char buf[500];
-  snprintf(buf, sizeof(buf), "%s-%04u.pgm", filename.c_str(), counter);
-  FILE *pgm = fopen(buf, "wb");
-  if (pgm) {
-    fprintf(pgm, "P5\n%u %u %u\n", width, height, 255u);
-    for (unsigned i = 0; i < image_size; i += stride) {
-      fwrite(image + i, 1, width, pgm);
-    }
-    fclose(pgm);
-  }
-}
-
-using namespace tesseract;
-
 #define TESSERACT_DEFAULT_PATH "<builtin default>"
 #ifndef TESSERACT_DATA_PATH
 #define TESSERACT_DATA_PATH TESSERACT_DEFAULT_PATH
 #endif
 
-TessBaseAPI *init_tesseract(std::string tesseract_data_path,
-                            char const *tess_lang, std::string blacklist,
-                            int tesseract_oem, int dpi) {
-  char const *tess_path = NULL;
-  if (tesseract_data_path != TESSERACT_DEFAULT_PATH)
-    tess_path = tesseract_data_path.c_str();
-
-  OcrEngineMode tess_oem = OEM_DEFAULT;
-  if (tesseract_oem != 3) {
-    switch (tesseract_oem) {
-      case 0:
-        tess_oem = OEM_TESSERACT_ONLY;
-        break;
-      case 1:
-        tess_oem = OEM_LSTM_ONLY;
-        break;
-      case 2:
-        tess_oem = OEM_TESSERACT_LSTM_COMBINED;
-        break;
-    }
+/// What to do with an image whose OCR exceeded --ocr-timeout
+enum timeout_policy_t {
+  TIMEOUT_EMPTY,      ///< emit an empty subtitle
+  TIMEOUT_DOWNSCALE,  ///< retry once with the image scaled to half size
+  TIMEOUT_LEGACY      ///< retry once with the legacy (non-LSTM) engine
+};
+
+// settings shared by all OCR threads
+struct ocr_config_t {
+  ocr_engine_type_t engine;
+  ocr_engine_config_t settings;
+  int timeout_ms;  // 0: no limit
+  timeout_policy_t timeout_policy;
+  // fast first tier, the engine above only gets the images it is unsure of
+  int cascade_confidence;  // 0: no cascade
+  std::string cascade_data_path;
+  int cascade_oem;
+  ocr_cache *cache;  // NULL: no --ocr-cache
+  resume_journal *journal;  // NULL: no --resume
+  telemetry_log *telemetry;  // NULL: no --telemetry
+  buffer_pool *images;  // of the jobs, do_ocr gives them back
+  progress_reporter *progress;  // NULL: no --progress-fd
+};
+
+// a decoded subtitle image waiting for a free OCR thread
+struct ocr_job_t {
+  ocr_job_t(unsigned counter, unsigned width, unsigned height, unsigned stride,
+            unsigned char *image, unsigned start_pts, unsigned end_pts,
+            cue_position_t const &position, unsigned long long cost,
+            uint64_t hash)
+      : counter(counter),
+        width(width),
+        height(height),
+        stride(stride),
+        image(image),
+        start_pts(start_pts),
+        end_pts(end_pts),
+        position(position),
+        cost(cost),
+        hash(hash) {}
+  ocr_job_t()
+      : counter(0),
+        width(0),
+        height(0),
+        stride(0),
+        image(NULL),
+        start_pts(0),
+        end_pts(0),
+        position(),
+        cost(0),
+        hash(0) {}
+  unsigned counter, width, height, stride;
+  unsigned char *image;  // from ocr_config_t::images, released by do_ocr
+  size_t capacity = 0;  // of image
+  unsigned start_pts, end_pts;
+  cue_position_t position;  // of the unscaled image
+  unsigned long long cost;  // see estimate_ocr_cost
+  uint64_t hash;  // image_hash for the OCR cache
+  // for --telemetry
+  chrono::steady_clock::time_point queued = chrono::steady_clock::now();
+  unsigned ink = 0;
+  int cache = -1;
+};
+
+struct ocr_thread_t {
+  ocr_thread_t(ocr_engine *engine, ocr_config_t const *config)
+      : engine(engine), config(config) {}
+  ~ocr_thread_t() {
+    delete engine;
+    delete legacy_engine;
+    delete fast_engine;
   }
+  thread *t = NULL;  // started with the first job, runs until quit
+  unsigned id = 0;  // for --telemetry
+  atomic<bool> done{false};  // ready for the next job
+  // the next job, handed over by post_job
+  mutex job_mut;
+  condition_variable job_ready;
+  ocr_job_t job;
+  bool has_job = false, quit = false;
+  ocr_engine *engine = NULL;
+  ocr_config_t const *config = NULL;
+  ocr_engine *legacy_engine = NULL;  // lazily created for TIMEOUT_LEGACY
+  bool legacy_failed = false;
+  ocr_engine *fast_engine = NULL;  // first tier of the cascade
+  chrono::steady_clock::time_point created = chrono::steady_clock::now();
+  chrono::steady_clock::duration busy{0};  // time spent in do_ocr
+  unsigned images = 0;
+  vector<float> latencies;  // of every image in ms, for --stats
+  // cascade statistics: images each tier recognized and the time it took
+  unsigned fast_runs = 0, fast_accepted = 0, accurate_runs = 0;
+  chrono::steady_clock::duration fast_time{0}, accurate_time{0};
+};
 
-  TessBaseAPI *tess_base_api = new TessBaseAPI();
-  if (tess_base_api->Init(tess_path, tess_lang, tess_oem) == -1) {
-    delete tess_base_api;
-    cerr << "Failed to initialize tesseract (OCR).\n";
+/// Creates and initializes an engine of config.engine with the data path
+/// and engine mode given. Returns NULL on failure.
+ocr_engine *start_engine(ocr_config_t const &config,
+                         std::string const &data_path, int oem) {
+  ocr_engine_config_t settings = config.settings;
+  settings.data_path = data_path;
+  settings.oem = oem;
+  ocr_engine *engine = ocr_engine::create(config.engine);
+  if (!engine->init(settings)) {
+    delete engine;
     return NULL;
   }
-  if (!blacklist.empty()) {
-    tess_base_api->SetVariable("tessedit_char_blacklist", blacklist.c_str());
+  return engine;
+}
+
+/// Recognizes the image. Returns NULL on failure and sets timed_out if
+/// --ocr-timeout was the reason.
+char *recognize(ocr_thread_t *ocr_thread, ocr_engine *engine,
+                unsigned char const *image, unsigned width, unsigned height,
+                unsigned stride, bool *timed_out, ocr_confidence_t *conf) {
+  trace_span span("recognize");
+  char *const text = engine->recognize(image, width, height, stride,
+                                       ocr_thread->config->timeout_ms,
+                                       timed_out);
+  if (text) *conf = engine->confidence();
+  return text;
+}
+
+/// Applies config->timeout_policy to an image that ran out of time
+char *recognize_after_timeout(ocr_thread_t *ocr_thread, ocr_job_t const &job,
+                              ocr_confidence_t *conf) {
+  ocr_config_t const *config = ocr_thread->config;
+  bool timed_out = false;
+  char *text = NULL;
+  switch (config->timeout_policy) {
+    case TIMEOUT_DOWNSCALE: {
+      unsigned const width = job.width / 2, height = job.height / 2;
+      if (width == 0 or height == 0) break;
+      unsigned char *half = new unsigned char[width * height];
+      downscale_half(job.image, job.width, job.height, job.stride, half);
+      text = recognize(ocr_thread, ocr_thread->engine, half, width, height,
+                       width, &timed_out, conf);
+      delete[] half;
+      break;
+    }
+    case TIMEOUT_LEGACY:
+      if (ocr_thread->legacy_engine == NULL and !ocr_thread->legacy_failed) {
+        ocr_thread->legacy_engine =
+            start_engine(*config, config->settings.data_path,
+                         0 /* OEM_TESSERACT_ONLY */);
+        ocr_thread->legacy_failed = ocr_thread->legacy_engine == NULL;
+      }
+      if (ocr_thread->legacy_engine) {
+        text = recognize(ocr_thread, ocr_thread->legacy_engine, job.image,
+                         job.width, job.height, job.stride, &timed_out, conf);
+      }
+      break;
+    case TIMEOUT_EMPTY:
+      break;
+  }
+  if (text == NULL) {
+    cerr << "WARNING: OCR of " << job.counter << " exceeded "
+         << config->timeout_ms << " ms, emitting an empty subtitle\n";
+    text = new char[1];
+    text[0] = '\0';
   }
-  char dpi_string[255];
-  snprintf(dpi_string, 254, "%d", dpi);
-  tess_base_api->SetVariable("user_defined_dpi", dpi_string);
-  return tess_base_api;
+  return text;
 }
 
-void do_ocr(TessBaseAPI *tess_base_api, atomic<bool> *done,
-            vector<sub_text_t> *conv_subs, mutex *mut, unsigned counter,
-            unsigned width, unsigned height, unsigned stride,
-            unsigned char *image_cpy, unsigned start_pts, unsigned end_pts,
-            bool verb) {
-  char *text =
-      tess_base_api->TesseractRect(image_cpy, 1, stride, 0, 0, width, height);
-  free(image_cpy);
+void do_ocr(ocr_thread_t *ocr_thread, ocr_job_t job,
+            vector<sub_text_t> *conv_subs, mutex *mut, bool verb) {
+  trace_span span("ocr", job.counter);
+  chrono::steady_clock::time_point const start = chrono::steady_clock::now();
+  bool timed_out = false;
+  ocr_confidence_t conf = {0, 0.0f, 0.0f};
+  char *text = NULL;
+  if (ocr_thread->fast_engine) {
+    text = recognize(ocr_thread, ocr_thread->fast_engine, job.image, job.width,
+                     job.height, job.stride, &timed_out, &conf);
+    ++ocr_thread->fast_runs;
+    ocr_thread->fast_time += chrono::steady_clock::now() - start;
+    if (text and conf.words > 0 and
+        conf.mean >= ocr_thread->config->cascade_confidence) {
+      ++ocr_thread->fast_accepted;
+    } else {
+      delete[] text;
+      text = NULL;
+    }
+  }
+  if (text == NULL) {
+    chrono::steady_clock::time_point const accurate_start =
+        chrono::steady_clock::now();
+    text = recognize(ocr_thread, ocr_thread->engine, job.image, job.width,
+                     job.height, job.stride, &timed_out, &conf);
+    if (timed_out) text = recognize_after_timeout(ocr_thread, job, &conf);
+    ++ocr_thread->accurate_runs;
+    ocr_thread->accurate_time += chrono::steady_clock::now() - accurate_start;
+  }
+  ocr_thread->config->images->release(job.image, job.capacity);
 
   if (!text) {
-    cerr << "ERROR: OCR failed for " << counter << endl;
+    // an empty cue like after a timeout, it is neither cached nor journaled
+    // so that another run tries again
+    cerr << "ERROR: OCR failed for " << job.counter << endl;
+    text = new char[1];
+    text[0] = '\0';
   } else {
     size_t size = strlen(text);
     while (size > 0 and isspace(text[--size])) {
       text[size] = '\0';
     }
     if (verb) {
-      cout << counter << " Text: " << text << endl;
+      cout << job.counter << " Text: " << text << " (confidence " << conf.mean
+           << ", lowest word " << conf.min << ")" << endl;
+    }
+    if (ocr_thread->config->cache and !timed_out) {
+      ocr_cache_entry_t const entry = {text, conf.words, conf.mean, conf.min};
+      ocr_thread->config->cache->insert(job.hash, entry);
+    }
+    if (ocr_thread->config->journal) {
+      journal_entry_t const entry = {job.counter, job.start_pts,
+                                     job.end_pts, text,       conf.words,
+                                     conf.mean,   conf.min,   timed_out};
+      ocr_thread->config->journal->add(entry);
     }
   }
   mut->lock();
-  conv_subs->push_back(sub_text_t(counter, start_pts, end_pts, text));
+  conv_subs->push_back(sub_text_t(job.counter, job.start_pts, job.end_pts,
+                                  job.position, text, conf, timed_out));
   mut->unlock();
-  done->store(true);
+  if (ocr_thread->config->progress) ocr_thread->config->progress->done();
+  chrono::steady_clock::duration const elapsed =
+      chrono::steady_clock::now() - start;
+  ocr_thread->busy += elapsed;
+  ++ocr_thread->images;
+  ocr_thread->latencies.push_back(
+      chrono::duration<float, milli>(elapsed).count());
+  if (ocr_thread->config->telemetry) {
+    telemetry_record_t record;
+    record.counter = job.counter;
+    record.start_pts = job.start_pts;
+    record.end_pts = job.end_pts;
+    record.position = job.position;
+    record.width = job.width;
+    record.height = job.height;
+    record.ink = job.ink;
+    record.cache = job.cache;
+    record.worker = ocr_thread->id;
+    record.queue_wait_ms =
+        chrono::duration<double, milli>(start - job.queued).count();
+    record.ocr_ms = chrono::duration<double, milli>(elapsed).count();
+    record.words = conf.words;
+    record.mean = conf.mean;
+    record.timed_out = timed_out;
+    ocr_thread->config->telemetry->add(record);
+  }
+  span.end();
+  ocr_thread->done.store(true);
 }
 
-struct ocr_thread_t {
-  ocr_thread_t(TessBaseAPI *tess_base_api) : tess_base_api(tess_base_api) {}
-  thread *t = NULL;
-  atomic<bool> done{false};
-  TessBaseAPI *tess_base_api = NULL;
-};
+/// Entry point of the OCR threads. They recognize one job after the other
+/// until they are told to quit, so that handing an image over to them
+/// doesn't allocate (unlike starting a thread).
+void run_ocr_thread(ocr_thread_t *ocr_thread, vector<sub_text_t> *conv_subs,
+                    mutex *mut, bool verb) {
+  trace_thread("OCR thread", ocr_thread->id);
+  unique_lock<mutex> lock(ocr_thread->job_mut);
+  for (;;) {
+    ocr_thread->job_ready.wait(
+        lock, [&]() { return ocr_thread->has_job or ocr_thread->quit; });
+    if (!ocr_thread->has_job) return;
+    ocr_job_t const job = ocr_thread->job;
+    ocr_thread->has_job = false;
+    lock.unlock();
+    do_ocr(ocr_thread, job, conv_subs, mut, verb);
+    lock.lock();
+  }
+}
+
+/// Hands the job to an idle OCR thread
+void post_job(ocr_thread_t *ocr_thread, ocr_job_t const &job) {
+  {
+    lock_guard<mutex> lock(ocr_thread->job_mut);
+    ocr_thread->job = job;
+    ocr_thread->has_job = true;
+    ocr_thread->done = false;
+  }
+  ocr_thread->job_ready.notify_one();
+}
+
+/// Lets the OCR thread finish its job and waits for it to end
+void stop_ocr_thread(ocr_thread_t *ocr_thread) {
+  if (ocr_thread->t == NULL) return;
+  {
+    lock_guard<mutex> lock(ocr_thread->job_mut);
+    ocr_thread->quit = true;
+  }
+  ocr_thread->job_ready.notify_one();
+  ocr_thread->t->join();
+  delete ocr_thread->t;
+  ocr_thread->t = NULL;
+}
+
+/// Converts a Matroska track language (ISO 639-2 or an IETF language tag) to
+/// ISO 639-3. Returns an empty string if it is unknown.
+std::string matroska_lang_to_639_3(std::string const &language) {
+  std::string const primary = language.substr(0, language.find('-'));
+  if (primary.size() == 2) {
+    char const *const lang3 = iso639_1_to_639_3(primary.c_str());
+    return lang3 ? lang3 : "";
+  }
+  if (primary.size() == 3 and primary != "und")
+    return iso639_2b_to_639_3(primary.c_str());
+  return "";
+}
+
+/// Size and modification time of an input file (empty if it can't be read),
+/// so that results are not reused for another file under the same name
+std::string file_identity(std::string const &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) < 0) return std::string();
+  std::ostringstream identity;
+  identity << st.st_size << ':' << st.st_mtime;
+  return identity.str();
+}
+
+/// Selects the Matroska track or DVD stream for --lang (the first one in a
+/// language of the comma separated list) or --index (compared with the id
+/// member). Defaults to the first one, returns NULL if the index is unknown.
+template <typename Track>
+Track const *select_track(vector<Track> const &tracks,
+                          std::string const &langs, int index,
+                          unsigned Track::*id) {
+  if (!langs.empty()) {
+    std::string::size_type start = 0;
+    while (start < langs.size()) {
+      std::string::size_type end = langs.find(',', start);
+      if (end == std::string::npos) end = langs.size();
+      std::string const lang3 =
+          matroska_lang_to_639_3(langs.substr(start, end - start));
+      for (size_t i = 0; !lang3.empty() and i < tracks.size(); ++i) {
+        if (matroska_lang_to_639_3(tracks[i].language) == lang3)
+          return &tracks[i];
+      }
+      start = end + 1;
+      while (start < langs.size() and langs[start] == ' ') ++start;
+    }
+    cerr << "No matching language for '" << langs
+         << "' found! (Trying to use default)\n";
+  } else if (index >= 0) {
+    for (size_t i = 0; i < tracks.size(); ++i) {
+      if (tracks[i].*id == static_cast<unsigned>(index)) return &tracks[i];
+    }
+    cerr << "No subtitle stream with index " << index << '\n';
+    return NULL;
+  }
+  return &tracks[0];
+}
 
 int main(int argc, char **argv) {
   bool dump_images = false;
+  std::string dump_format;
+  std::string write_corpus;
+  std::string ocr_from_corpus;
   bool verb = false;
   bool list_languages = false;
   bool dumb = false;
+  bool index_cache = false;
   std::string ifo_file;
+  std::string sub_stream;
+  std::string unrar_path = "/usr/bin/unrar";
   std::string subname;
   std::string lang;
   std::string tess_lang_user;
   std::string blacklist;
   std::string tesseract_data_path = TESSERACT_DATA_PATH;
   int tesseract_oem = 3;
+  int tesseract_psm = tesseract_default_psm;
+  std::string ocr_engine_name = "tesseract";
+  int ocr_latency = 0;
   int index = -1;
   int y_threshold = 0;
   int min_width = 9;
   int min_height = 1;
   int dpi = 72;
   int max_threads = 0;
+  int lookahead = 0;
+  int ocr_timeout = 0;
+  std::string timeout_policy = "empty";
+  int cascade_confidence = 0;
+  std::string cascade_data_path;
+  int cascade_oem = 0;
+  int scale_height = 0;
+  int title_set = 0;
+  std::string ocr_cache_file;
+  int ocr_cache_size = 64;
+  bool resume = false;
+  bool show_stats = false;
+  std::string stats_json;
+  std::string telemetry_file;
+  std::string trace_file;
+  int progress_fd = -1;
+  std::string output_file;
+  std::string format = "srt";
 
   {
     /************************************************************************************
@@ -208,10 +499,33 @@ int main(int argc, char **argv) {
     cmd_options opts;
     opts.add_option("dump-images", dump_images,
                     "dump subtitles as image files (<subname>-<number>.pgm)")
+        .add_option("dump-format", dump_format,
+                    "format of the dumped images: pgm, png, tiff (one multi-"
+                    "page <subname>-images.tiff) or tar (PGM files in "
+                    "<subname>-images.tar), implies --dump-images")
+        .add_option("write-corpus", write_corpus,
+                    "write the prepared OCR input images to this file for "
+                    "--ocr-from-corpus")
+        .add_option("ocr-from-corpus", ocr_from_corpus,
+                    "recognize the images of a --write-corpus file instead of "
+                    "reading subtitles (e.g. to compare OCR settings)")
         .add_option("verbose", verb, "increase logging level")
         .add_option(
             "ifo", ifo_file,
             "name of the ifo file (default: tries to open <subname>.ifo")
+        .add_option("sub-stream", sub_stream,
+                    "read the .sub data from this file (e.g. a pipe) or - for "
+                    "stdin while it arrives, only <subname>.idx is read from "
+                    "the disk")
+        .add_option("index-cache", index_cache,
+                    "keep the parsed .idx/.sub index in <subname>.v2sidx to "
+                    "open the files faster next time")
+        .add_option("unrar", unrar_path,
+                    "unrar executable used to read the subtitles from "
+                    "<subname>.rar (default: /usr/bin/unrar)")
+        .add_option("title-set", title_set,
+                    "DVD title set to read from a VIDEO_TS directory or ISO "
+                    "image (default: the largest)")
         .add_option("lang", lang, "language to select", 'l')
         .add_option("langlist", list_languages, "list languages and exit")
         .add_option("dumb", dumb, "use forced next timestamp as end_pts")
@@ -222,6 +536,15 @@ int main(int argc, char **argv) {
                     "path to tesseract data (Default: " TESSERACT_DATA_PATH ")")
         .add_option("tesseract-oem", tesseract_oem,
                     "Tesseract Engine mode to use")
+        .add_option("tesseract-psm", tesseract_psm,
+                    "Tesseract page segmentation mode, e.g. 6 for a single "
+                    "block or 7 for a single line (default: 6)")
+        .add_option("ocr-engine", ocr_engine_name,
+                    "OCR engine: tesseract, or fake to test and benchmark "
+                    "without OCR (default: tesseract)")
+        .add_option("ocr-latency", ocr_latency,
+                    "milliseconds the fake OCR engine takes per image "
+                    "(default: 0)")
         .add_option(
             "blacklist", blacklist,
             "Character blacklist to improve the OCR (e.g. \"|\\/`_~<>\")")
@@ -235,48 +558,96 @@ int main(int argc, char **argv) {
                     "minimum height in pixels to consider a subpicture for OCR "
                     "(default: 1)")
         .add_option("dpi", dpi, "DPI of the subtitle images (default: 72)")
+        .add_option("scale-height", scale_height,
+                    "scale each image so its tallest text line is this many "
+                    "pixels high, use 0 to disable (default: 0)")
         .add_option("max-threads", max_threads,
                     "maximum number of threads to use, use 0 to "
                     "autodetect the number of cores (default: 0)")
+        .add_option("lookahead", lookahead,
+                    "number of decoded images to schedule largest first, use "
+                    "0 for four per thread and 1 for strict order (default: "
+                    "0)")
+        .add_option("ocr-timeout", ocr_timeout,
+                    "time limit in milliseconds for the OCR of one image, use "
+                    "0 for no limit (default: 0)")
+        .add_option("timeout-policy", timeout_policy,
+                    "what to do when --ocr-timeout is hit: empty, downscale "
+                    "or legacy (default: empty)")
+        .add_option("cascade-confidence", cascade_confidence,
+                    "recognize with a fast engine first and only use the "
+                    "--tesseract-oem engine if the mean word confidence is "
+                    "below this, use 0 to disable (default: 0)")
+        .add_option("cascade-data", cascade_data_path,
+                    "path to tesseract data for the fast engine, e.g. "
+                    "tessdata_fast (default: --tesseract-data)")
+        .add_option("cascade-oem", cascade_oem,
+                    "Tesseract Engine mode of the fast engine (default: 0)")
+        .add_option("ocr-cache", ocr_cache_file,
+                    "file to keep OCR results in, identical images (e.g. "
+                    "from a re-run or another episode) are not recognized "
+                    "again")
+        .add_option("ocr-cache-size", ocr_cache_size,
+                    "size limit of the --ocr-cache file in MiB, the least "
+                    "recently used results are dropped (default: 64)")
+        .add_option("output", output_file,
+                    "file to write the subtitles to, - for stdout (default: "
+                    "<subname>.srt or the extension of --format)",
+                    'o')
+        .add_option("format", format,
+                    "subtitle format: srt, vtt (WebVTT), ass (positioned like "
+                    "on the DVD) or ndjson (one JSON object with confidence "
+                    "per subtitle) (default: srt)")
+        .add_option("resume", resume,
+                    "keep finished subtitles in <subname>.v2sjournal and "
+                    "continue an interrupted conversion from there")
+        .add_option("stats", show_stats,
+                    "print where the time went: per stage, per OCR thread, "
+                    "OCR latency percentiles, peak queue depths and memory")
+        .add_option("stats-json", stats_json,
+                    "write the numbers of --stats as JSON to this file")
+        .add_option("telemetry", telemetry_file,
+                    "write one JSON object per subtitle image with its "
+                    "geometry, OCR time, queue wait and confidence to this "
+                    "file")
+        .add_option("trace", trace_file,
+                    "record the decoding, image preparation, OCR and "
+                    "writing of every subtitle on a timeline in this JSON "
+                    "file (Chrome trace event format)")
+        .add_option("progress-fd", progress_fd,
+                    "write the progress and an ETA as one JSON object per "
+                    "line to this file descriptor, about once a second")
         .add_unnamed(
             subname, "subname",
             "name of the subtitle files WITHOUT .idx/.sub ending! (REQUIRED)");
-    if (!opts.parse_cmd(argc, argv) or subname.empty()) {
+    if (!opts.parse_cmd(argc, argv) or
+        (subname.empty() and ocr_from_corpus.empty())) {
       return 1;
     }
   }
 
+  subtitle_format_t output_format;
+  if (!parse_subtitle_format(format, &output_format)) {
+    cerr << "Unknown subtitle format '" << format << "'\n";
+    return 1;
+  }
+  std::unique_ptr<subtitle_writer> writer(
+      subtitle_writer::create(output_format));
+  // stdout is taken over right away, so that no message ends up in the
+  // subtitles
+  if (output_file == "-" and !writer->open(output_file)) return 1;
+
   // Init the mplayer part
   verbose = verb;  // mplayer verbose level
   mp_msg_init();
+  unrar_executable = const_cast<char *>(unrar_path.c_str());
+  vobsub_index_cache = index_cache;
 
   // Set Y threshold from command-line arg only if given
   if (y_threshold) {
     cout << "Using Y palette threshold: " << y_threshold << endl;
   }
 
-  // Open the sub/idx subtitles
-  spu_t spu;
-  vob_t vob =
-      vobsub_open(subname.c_str(), ifo_file.empty() ? 0x0 : ifo_file.c_str(), 1,
-                  y_threshold, &spu);
-  if (!vob or vobsub_get_indexes_count(vob) == 0) {
-    cerr << "Couldn't open VobSub files '" << subname << ".idx/.sub'" << endl;
-    return 1;
-  }
-
-  // list languages and exit
-  if (list_languages) {
-    cout << "Languages:\n";
-    for (size_t i = 0; i < vobsub_get_indexes_count(vob); ++i) {
-      char const *const id = vobsub_get_id(vob, i);
-      cout << i << ": " << (id ? id : "(no id)") << endl;
-    }
-    return 0;
-  }
-
-  // Handle stream Ids and language
-
   if (!lang.empty() and index >= 0) {
     cerr << "Setting both lang and index not supported.\n";
     return 1;
@@ -285,49 +656,268 @@ int main(int argc, char **argv) {
   // default english
   char const *tess_lang =
       tess_lang_user.empty() ? "eng" : tess_lang_user.c_str();
-  if (!lang.empty()) {
-    if (vobsub_set_from_lang(vob, (unsigned char *)lang.c_str()) < 0) {
-      cerr << "No matching language for '" << lang
-           << "' found! (Trying to use default)\n";
-    } else if (tess_lang_user.empty()) {
-      // convert two letter lang code into three letter lang code (required by
-      // tesseract)
-      char const *const lang3 = iso639_1_to_639_3(lang.c_str());
-      if (lang3) {
-        tess_lang = lang3;
+
+  spu_t spu = NULL;
+  vob_t vob = NULL;
+  matroska_reader mkv;
+  bool const matroska = is_matroska_file(subname);
+  std::string outname = subname;  // for the .srt and the dumped images
+  std::string track_lang;
+  dvd_input dvd;
+  bool const dvd_mode = !matroska and is_dvd_input(subname);
+  corpus_reader corpus_in;
+  bool const corpus_mode = !ocr_from_corpus.empty();
+  conversion_stats stats;
+  stats.enter(STAGE_OPEN);
+  if (!trace_file.empty()) trace_start();
+  trace_span open_span("open");
+  if (!sub_stream.empty() and (corpus_mode or dvd_mode or matroska)) {
+    cerr << "--sub-stream only works with .idx/.sub subtitles\n";
+    return 1;
+  }
+  if (corpus_mode) {
+    // Replay the prepared images of an earlier run, without any decoding
+    outname = ocr_from_corpus.substr(0, ocr_from_corpus.rfind('.'));
+    if (!corpus_in.open(ocr_from_corpus)) return 1;
+    if (tess_lang_user.empty() and !corpus_in.language().empty()) {
+      track_lang = corpus_in.language();
+      tess_lang = track_lang.c_str();
+    }
+  } else if (dvd_mode) {
+    // Read the subtitle packets straight from the VOBs of a DVD
+    outname = subname;
+    while (outname.size() > 1 and outname[outname.size() - 1] == '/')
+      outname.erase(outname.size() - 1);
+    std::string::size_type const slash = outname.rfind('/');
+    std::string base =
+        outname.substr(slash == std::string::npos ? 0 : slash + 1);
+    std::transform(base.begin(), base.end(), base.begin(), ::toupper);
+    if (base == "VIDEO_TS" and slash != std::string::npos and slash > 0)
+      outname.erase(slash);
+    else if (base.size() > 4 and base.compare(base.size() - 4, 4, ".ISO") == 0)
+      outname.erase(outname.size() - 4);
+    if (title_set < 0 or title_set > 99) {
+      cerr << "Invalid title set " << title_set << " (1-99)\n";
+      return 1;
+    }
+    if (!dvd.open(subname, title_set)) return 1;
+    vector<dvd_stream_t> const &streams = dvd.streams();
+    if (list_languages) {
+      cout << "Languages (title set " << dvd.title_set() << "):\n";
+      for (size_t i = 0; i < streams.size(); ++i) {
+        cout << streams[i].index << ": "
+             << (streams[i].language.empty() ? "(no id)"
+                                             : streams[i].language)
+             << endl;
       }
+      return 0;
     }
+    dvd_stream_t const *const stream =
+        select_track(streams, lang, index, &dvd_stream_t::index);
+    if (stream == NULL or !dvd.select(stream->index)) return 1;
+    if (tess_lang_user.empty()) {
+      track_lang = matroska_lang_to_639_3(stream->language);
+      if (!track_lang.empty()) tess_lang = track_lang.c_str();
+    }
+    vector<unsigned> palette(dvd.palette(), dvd.palette() + 16);
+    spu = spudec_new_scaled(palette.data(), dvd.width(), dvd.height(), NULL, 0,
+                            y_threshold);
+  } else if (matroska) {
+    // Read the VobSub track straight from the Matroska blocks
+    outname = subname.substr(0, subname.rfind('.'));
+    if (!mkv.open(subname)) return 1;
+    vector<mkv_track_t> const &tracks = mkv.tracks();
+    if (list_languages) {
+      cout << "Languages:\n";
+      for (size_t i = 0; i < tracks.size(); ++i) {
+        cout << tracks[i].id << ": " << tracks[i].language;
+        if (!tracks[i].name.empty()) cout << " (" << tracks[i].name << ')';
+        cout << endl;
+      }
+      return 0;
+    }
+    mkv_track_t const *const track =
+        select_track(tracks, lang, index, &mkv_track_t::id);
+    if (track == NULL or !mkv.select(track->id)) return 1;
+    if (tess_lang_user.empty()) {
+      track_lang = matroska_lang_to_639_3(track->language);
+      if (!track_lang.empty()) tess_lang = track_lang.c_str();
+    }
+    vector<unsigned char> idx_header = track->codec_private;
+    spu = spudec_new_scaled(NULL, 0, 0, idx_header.data(), idx_header.size(),
+                            y_threshold);
   } else {
-    if (index >= 0) {
-      if (static_cast<unsigned>(index) >= vobsub_get_indexes_count(vob)) {
-        cerr << "Index argument out of range: " << index << " ("
-             << vobsub_get_indexes_count(vob) << ")\n";
+    // Open the sub/idx subtitles
+    int sub_fd = -1;
+    if (sub_stream == "-") {
+      sub_fd = STDIN_FILENO;
+    } else if (!sub_stream.empty()) {
+      sub_fd = open(sub_stream.c_str(), O_RDONLY);
+      if (sub_fd < 0) {
+        cerr << "Can't open " << sub_stream << ": " << strerror(errno) << '\n';
         return 1;
       }
-      vobsub_id = index;
+    }
+    vob = vobsub_open_stream(subname.c_str(),
+                             ifo_file.empty() ? 0x0 : ifo_file.c_str(), sub_fd,
+                             1, y_threshold, &spu);
+    if (!vob or vobsub_get_indexes_count(vob) == 0) {
+      cerr << "Couldn't open VobSub files '" << subname << ".idx/.sub'"
+           << endl;
+      return 1;
     }
 
-    if (vobsub_id >=
-        0) {  // try to set correct tesseract lang for default stream
-      char const *const lang1 = vobsub_get_id(vob, vobsub_id);
-      if (lang1 and tess_lang_user.empty()) {
-        char const *const lang3 = iso639_1_to_639_3(lang1);
+    // list languages and exit
+    if (list_languages) {
+      cout << "Languages:\n";
+      for (size_t i = 0; i < vobsub_get_indexes_count(vob); ++i) {
+        char const *const id = vobsub_get_id(vob, i);
+        cout << i << ": " << (id ? id : "(no id)") << endl;
+      }
+      return 0;
+    }
+
+    // Handle stream Ids and language
+    if (!lang.empty()) {
+      if (vobsub_set_from_lang(vob, (unsigned char *)lang.c_str()) < 0) {
+        cerr << "No matching language for '" << lang
+             << "' found! (Trying to use default)\n";
+      } else if (tess_lang_user.empty()) {
+        // convert two letter lang code into three letter lang code
+        // (required by tesseract)
+        char const *const lang3 = iso639_1_to_639_3(lang.c_str());
         if (lang3) {
           tess_lang = lang3;
         }
       }
+    } else {
+      if (index >= 0) {
+        if (static_cast<unsigned>(index) >= vobsub_get_indexes_count(vob)) {
+          cerr << "Index argument out of range: " << index << " ("
+               << vobsub_get_indexes_count(vob) << ")\n";
+          return 1;
+        }
+        vobsub_id = index;
+      }
+
+      if (vobsub_id >=
+          0) {  // try to set correct tesseract lang for default stream
+        char const *const lang1 = vobsub_get_id(vob, vobsub_id);
+        if (lang1 and tess_lang_user.empty()) {
+          char const *const lang3 = iso639_1_to_639_3(lang1);
+          if (lang3) {
+            tess_lang = lang3;
+          }
+        }
+      }
     }
   }
 
-  // Open srt output file
-  string const srt_filename = subname + ".srt";
-  FILE *srtout = fopen(srt_filename.c_str(), "w");
-  if (!srtout) {
-    perror("could not open .srt file");
+  open_span.end();
+
+  // Open the output file
+  if (output_file.empty())
+    output_file = outname + '.' + subtitle_extension(output_format);
+  if (output_file != "-" and !writer->open(output_file)) return 1;
+
+  if (max_threads <= 0) max_threads = thread::hardware_concurrency();
+
+  ocr_config_t ocr_config;
+  if (!parse_ocr_engine(ocr_engine_name, &ocr_config.engine)) {
+    cerr << "Unknown OCR engine '" << ocr_engine_name << "'\n";
+    return 1;
+  }
+  // the engines take an empty path for their built-in default
+  auto const engine_path = [](std::string const &path) {
+    return path == TESSERACT_DEFAULT_PATH ? std::string() : path;
+  };
+  ocr_config.settings.data_path = engine_path(tesseract_data_path);
+  ocr_config.settings.lang = tess_lang;
+  ocr_config.settings.blacklist = blacklist;
+  ocr_config.settings.oem = tesseract_oem;
+  if (tesseract_psm < 0 or tesseract_psm >= tesseract_psm_count) {
+    cerr << "Invalid page segmentation mode " << tesseract_psm << '\n';
+    return 1;
+  }
+  ocr_config.settings.psm = tesseract_psm;
+  ocr_config.settings.dpi = dpi;
+  ocr_config.settings.latency_ms = ocr_latency;
+  ocr_config.timeout_ms = ocr_timeout;
+  if (timeout_policy == "empty") {
+    ocr_config.timeout_policy = TIMEOUT_EMPTY;
+  } else if (timeout_policy == "downscale") {
+    ocr_config.timeout_policy = TIMEOUT_DOWNSCALE;
+  } else if (timeout_policy == "legacy") {
+    ocr_config.timeout_policy = TIMEOUT_LEGACY;
+  } else {
+    cerr << "Unknown timeout policy '" << timeout_policy << "'\n";
     return 1;
   }
+  ocr_config.cascade_confidence = cascade_confidence;
+  if (cascade_data_path.empty()) cascade_data_path = tesseract_data_path;
+  ocr_config.cascade_data_path = engine_path(cascade_data_path);
+  ocr_config.cascade_oem = cascade_oem;
+  ocr_config.cache = NULL;
+  ocr_config.journal = NULL;
+  ocr_config.telemetry = NULL;
+  ocr_config.images = NULL;
+  ocr_config.progress = NULL;
 
-  if (max_threads <= 0) max_threads = thread::hardware_concurrency();
+  // everything that changes the text of an image
+  std::unique_ptr<ocr_engine> const engine(
+      ocr_engine::create(ocr_config.engine));
+  std::ostringstream settings;
+  settings << engine->version() << '\0' << tess_lang << '\0'
+           << tesseract_data_path << '\0' << tesseract_oem << '\0'
+           << tesseract_psm << '\0' << blacklist << '\0' << dpi << '\0'
+           << cascade_confidence << '\0' << cascade_data_path << '\0'
+           << cascade_oem;
+
+  ocr_cache cache;
+  if (!ocr_cache_file.empty()) {
+    if (!cache.open(ocr_cache_file, settings.str(),
+                    static_cast<uint64_t>(max(ocr_cache_size, 1)) << 20))
+      return 1;
+    ocr_config.cache = &cache;
+  }
+
+  resume_journal journal;
+  if (resume) {
+    // and everything that changes which images get which counter
+    settings << '\0' << subname << '\0' << ifo_file << '\0' << lang << '\0'
+             << index << '\0' << title_set << '\0' << y_threshold << '\0'
+             << min_width << '\0' << min_height << '\0' << scale_height
+             << '\0' << ocr_from_corpus << '\0';
+    // and the input files themselves
+    if (corpus_mode)
+      settings << file_identity(ocr_from_corpus);
+    else if (matroska or dvd_mode)
+      settings << file_identity(subname);
+    else
+      settings << file_identity(subname + ".idx") << '\0'
+               << file_identity(sub_stream.empty() ? subname + ".sub"
+                                                   : sub_stream);
+    if (!journal.open(outname + ".v2sjournal", settings.str())) return 1;
+    if (journal.resumed() > 0)
+      cout << "Resuming with " << journal.resumed()
+           << " subtitles from the journal\n";
+    ocr_config.journal = &journal;
+  }
+
+  telemetry_log telemetry;
+  if (!telemetry_file.empty()) {
+    if (!telemetry.open(telemetry_file)) return 1;
+    ocr_config.telemetry = &telemetry;
+  }
+
+  progress_reporter progress;
+  if (progress_fd >= 0) {
+    // the .idx lists the packets, Matroska and DVD input only know the
+    // total at the end
+    if (!progress.start(progress_fd, vob ? vobsub_get_packet_count(vob) : 0))
+      return 1;
+    ocr_config.progress = &progress;
+  }
 
   vector<ocr_thread_t *> threads;
 
@@ -337,13 +927,279 @@ int main(int argc, char **argv) {
   int len;
   unsigned last_start_pts = 0;
   unsigned sub_counter = 1;
+  unsigned frame_width = 0, frame_height = 0;  // for the ASS header
+  if (corpus_mode) {
+    frame_width = corpus_in.frame_width();
+    frame_height = corpus_in.frame_height();
+  } else {
+    unsigned x, y;
+    spudec_get_position(spu, &x, &y, &frame_width, &frame_height);
+  }
 
   vector<sub_text_t> conv_subs;
   conv_subs.reserve(4096);  // TODO better estimate
   mutex mut;
 
-  while ((len = vobsub_get_next_packet(vob, &packet, &timestamp)) > 0) {
+  // Decoded images wait in a small window and the most expensive one is
+  // handed out first. A few huge late images (credits, signs) otherwise decide
+  // when the last thread finishes. The output is sorted by counter anyway.
+  if (lookahead <= 0) lookahead = 4 * max_threads;
+  vector<ocr_job_t> pending;
+  pending.reserve(lookahead);
+  // the copies for the OCR threads and the inverted and scaled images are
+  // reused, so a conversion stops allocating once it has seen its largest
+  // images
+  buffer_pool job_images(&stats.memory[MEMORY_JOBS]);
+  buffer_pool prepared_images(&stats.memory[MEMORY_PREPARE]);
+  ocr_config.images = &job_images;
+  chrono::steady_clock::time_point ocr_start;
+
+  image_dumper dumper;
+  if (dump_images or !dump_format.empty()) {
+    image_dump_format_t format = DUMP_PGM;
+    if (!dump_format.empty() and
+        !parse_image_dump_format(dump_format, &format)) {
+      cerr << "Unknown image format '" << dump_format << "'\n";
+      return 1;
+    }
+    if (!dumper.start(outname, format)) return 1;
+  }
+
+  corpus_writer corpus_out;
+  if (!write_corpus.empty() and
+      !corpus_out.open(write_corpus, tess_lang, frame_width, frame_height))
+    return 1;
+
+  // debug builds check that preparing and queueing an image doesn't allocate
+  // on the heap, except while the buffers grow. The options below allocate
+  // per image by design.
+  hot_path_check hot_path;
+  hot_path.enabled = !ocr_config.cache and !ocr_config.telemetry and
+                     !dump_images and dump_format.empty() and
+                     !corpus_out.is_open() and !trace_enabled and !verb;
+
+  auto dispatch_largest = [&]() -> bool {
+    stats_stage_t const stage = stats.enter(STAGE_WAIT);
+    trace_span wait_span("wait");
+    ocr_thread_t *ocr_thread = NULL;
+    if (threads.empty()) ocr_start = chrono::steady_clock::now();
+    if (threads.size() < static_cast<unsigned>(max_threads)) {
+      stats.enter(STAGE_INIT);
+      trace_span init_span("init");
+      buffer_growth growing;  // once per thread, the engines allocate a lot
+      // approximate, the threads already running allocate as well
+      uint64_t const resident = resident_bytes();
+      ocr_engine *const engine =
+          start_engine(ocr_config, ocr_config.settings.data_path,
+                       ocr_config.settings.oem);
+      if (engine == NULL) return false;
+      ocr_thread = new ocr_thread_t(engine, &ocr_config);
+      ocr_thread->id = threads.size();
+      threads.push_back(ocr_thread);
+      if (ocr_config.cascade_confidence > 0) {
+        ocr_thread->fast_engine = start_engine(
+            ocr_config, ocr_config.cascade_data_path, ocr_config.cascade_oem);
+        if (ocr_thread->fast_engine == NULL) return false;
+      }
+      uint64_t const with_engines = resident_bytes();
+      if (with_engines > resident)
+        stats.memory[MEMORY_ENGINES].allocate(with_engines - resident);
+    } else if (max_threads == 1) {
+      ocr_thread = threads[0];
+    } else {
+      while (ocr_thread == NULL) {
+        for (unsigned i = 0; i < threads.size(); i++) {
+          if (threads[i]->done) {
+            ocr_thread = threads[i];
+            break;
+          }
+        }
+        if (ocr_thread == NULL) usleep(50);
+      }
+    }
+
+    vector<ocr_job_t>::iterator largest = max_element(
+        pending.begin(), pending.end(),
+        [](ocr_job_t const &a, ocr_job_t const &b) { return a.cost < b.cost; });
+    ocr_job_t const job = *largest;
+    *largest = pending.back();
+    pending.pop_back();
+    wait_span.end();
+
+    if (max_threads == 1) {
+      hot_path.end();  // the OCR itself allocates
+      stats.enter(STAGE_OCR);
+      do_ocr(ocr_thread, job, &conv_subs, &mut, verb);
+    } else {
+      post_job(ocr_thread, job);
+      if (ocr_thread->t == NULL) {
+        buffer_growth growing;
+        ocr_thread->t = new thread(run_ocr_thread, ocr_thread, &conv_subs,
+                                   &mut, verb);
+      }
+    }
+    stats.enter(stage);
+    return true;
+  };
+
+  // packets come from the .sub file or straight from the Matroska blocks or
+  // the DVD VOBs
+  auto next_packet = [&]() -> int {
+    if (corpus_mode) return 0;  // the images come from the corpus instead
+    stats.enter(STAGE_READ);
+    trace_span span("read");
+    if (!matroska and !dvd_mode)
+      return vobsub_get_next_packet(vob, &packet, &timestamp);
+    unsigned char *data;
+    unsigned pts100;
+    int const size = dvd_mode ? dvd.next_packet(&data, &pts100)
+                              : mkv.next_packet(&data, &pts100);
+    packet = data;
+    timestamp = pts100;
+    return size;
+  };
+
+  // Hands a prepared image to the OCR, unless the cache knows its text
+  auto queue_image = [&](unsigned counter, unsigned start_pts,
+                         unsigned end_pts, cue_position_t const &position,
+                         unsigned char const *image, size_t image_size,
+                         unsigned width, unsigned height, unsigned stride,
+                         unsigned lines) -> bool {
+    trace_span span("queue", counter);
+    dumper.dump(counter, image, width, height, stride);
+    if (corpus_out.is_open()) {
+      corpus_image_t const record = {counter, start_pts, end_pts, position,
+                                     width,   height,    lines,   {}};
+      corpus_out.add(record, image, stride);
+    }
+
+    unsigned const ink =
+        ocr_config.telemetry ? count_ink(image, width, height, stride) : 0;
+    uint64_t hash = 0;
+    if (ocr_config.cache) {
+      hash = image_hash(image, width, height, stride);
+      ocr_cache_entry_t entry;
+      if (ocr_config.cache->lookup(hash, &entry)) {
+        if (ocr_config.telemetry) {
+          telemetry_record_t record;
+          record.counter = counter;
+          record.start_pts = start_pts;
+          record.end_pts = end_pts;
+          record.position = position;
+          record.width = width;
+          record.height = height;
+          record.ink = ink;
+          record.source = SOURCE_CACHE;
+          record.cache = 1;
+          record.words = entry.words;
+          record.mean = entry.mean;
+          ocr_config.telemetry->add(record);
+        }
+        char *text = new char[entry.text.size() + 1];
+        memcpy(text, entry.text.c_str(), entry.text.size() + 1);
+        if (verb) cout << counter << " Text: " << text << " (cached)\n";
+        ocr_confidence_t const conf = {entry.words, entry.mean, entry.min};
+        mut.lock();
+        conv_subs.push_back(
+            sub_text_t(counter, start_pts, end_pts, position, text, conf));
+        mut.unlock();
+        if (ocr_config.progress) ocr_config.progress->done();
+        if (ocr_config.journal) {
+          journal_entry_t const journal_entry = {
+              counter,     start_pts,  end_pts,   entry.text,
+              entry.words, entry.mean, entry.min, false};
+          ocr_config.journal->add(journal_entry);
+        }
+        return true;
+      }
+    }
+
+    size_t capacity;
+    unsigned char *image_cpy = job_images.acquire(image_size, &capacity);
+    memcpy(image_cpy, image, image_size);
+
+    pending.push_back(ocr_job_t(counter, width, height, stride, image_cpy,
+                                start_pts, end_pts, position,
+                                estimate_ocr_cost(width, height, lines),
+                                hash));
+    pending.back().capacity = capacity;
+    pending.back().ink = ink;
+    if (ocr_config.cache) pending.back().cache = 0;
+    stats.queue_depth(pending.size());
+    bool const ok = pending.size() < static_cast<unsigned>(lookahead) or
+                    dispatch_largest();
+    hot_path.end();
+    return ok;
+  };
+
+  // Takes the cue from the journal if an earlier, interrupted run finished it
+  auto replay_journal = [&](unsigned counter, cue_position_t const &position,
+                            unsigned width, unsigned height) -> bool {
+    journal_entry_t const *const entry = journal.find(counter);
+    if (entry == NULL) return false;
+    if (ocr_config.telemetry) {
+      telemetry_record_t record;
+      record.counter = counter;
+      record.start_pts = entry->start_pts;
+      record.end_pts = entry->end_pts;
+      record.position = position;
+      record.width = width;
+      record.height = height;
+      record.source = SOURCE_JOURNAL;
+      record.words = entry->words;
+      record.mean = entry->mean;
+      record.timed_out = entry->timed_out;
+      ocr_config.telemetry->add(record);
+    }
+    char *text = new char[entry->text.size() + 1];
+    memcpy(text, entry->text.c_str(), entry->text.size() + 1);
+    ocr_confidence_t const conf = {entry->words, entry->mean, entry->min};
+    mut.lock();
+    conv_subs.push_back(sub_text_t(counter, entry->start_pts, entry->end_pts,
+                                   position, text, conf, entry->timed_out));
+    mut.unlock();
+    if (ocr_config.progress) ocr_config.progress->done();
+    return true;
+  };
+
+  // The C parts keep their own memory counters
+  auto poll_memory = [&]() {
+    size_t bytes;
+    unsigned long allocations;
+    if (spu) {
+      spudec_get_memory(spu, &bytes, &allocations);
+      stats.memory[MEMORY_DECODER].set(bytes, allocations);
+    }
+    if (vob) {
+      uint64_t packet_bytes, peak;
+      vobsub_get_memory(vob, &packet_bytes, &peak, &allocations);
+      stats.memory[MEMORY_PACKETS].set(packet_bytes, allocations, peak);
+    }
+  };
+
+  corpus_image_t replayed;
+  stats.enter(STAGE_READ);
+  while (corpus_mode and corpus_in.next(&replayed)) {
+    if (ocr_config.progress) ocr_config.progress->decoded();
+    stats.enter(STAGE_PREPARE);
+    if (replay_journal(replayed.counter, replayed.position, replayed.width,
+                       replayed.height)) {
+      stats.enter(STAGE_READ);
+      continue;
+    }
+    if (!queue_image(replayed.counter, replayed.start_pts, replayed.end_pts,
+                     replayed.position, replayed.image.data(),
+                     replayed.image.size(), replayed.width, replayed.height,
+                     replayed.width, replayed.lines))
+      return -1;
+    stats.enter(STAGE_READ);
+  }
+
+  while ((len = next_packet()) > 0) {
+    if (ocr_config.progress) ocr_config.progress->packet_read();
+    stats.enter(STAGE_DECODE);
     if (timestamp >= 0) {
+      trace_span decode_span("decode", sub_counter);
       spudec_assemble(spu, reinterpret_cast<unsigned char *>(packet), len,
                       timestamp);
       spudec_heartbeat(spu, timestamp);
@@ -352,6 +1208,8 @@ int main(int argc, char **argv) {
       unsigned width, height, stride, start_pts, end_pts;
       spudec_get_data(spu, &image, &image_size, &width, &height, &stride,
                       &start_pts, &end_pts);
+      decode_span.end();
+      poll_memory();
 
       // skip this packet if it is another packet of a subtitle that
       // was decoded from multiple mpeg packets.
@@ -359,6 +1217,7 @@ int main(int argc, char **argv) {
         continue;
       }
       last_start_pts = start_pts;
+      if (ocr_config.progress) ocr_config.progress->decoded();
 
       if (width < (unsigned int)min_width ||
           height < (unsigned int)min_height) {
@@ -366,6 +1225,20 @@ int main(int argc, char **argv) {
              << ", size: " << image_size << " bytes, " << width << "x" << height
              << " pixels, expected at least " << min_width << "x" << min_height
              << endl;
+        if (ocr_config.telemetry) {
+          telemetry_record_t record;
+          record.counter = sub_counter;
+          record.start_pts = start_pts;
+          record.end_pts = end_pts;
+          spudec_get_position(spu, &record.position.x, &record.position.y,
+                              &frame_width, &frame_height);
+          record.position.width = record.width = width;
+          record.position.height = record.height = height;
+          record.source = SOURCE_REJECTED;
+          record.reason = "too small";
+          ocr_config.telemetry->add(record);
+        }
+        if (ocr_config.progress) ocr_config.progress->done();
         continue;
       }
 
@@ -374,71 +1247,117 @@ int main(int argc, char **argv) {
              << ") doesn't match time stamp from .sub (" << start_pts << ")\n";
       }
 
+      cue_position_t position = {0, 0, width, height};
+      spudec_get_position(spu, &position.x, &position.y, &frame_width,
+                          &frame_height);
+      stats.enter(STAGE_PREPARE);
+      trace_span prepare_span("prepare", sub_counter);
+
+      if (replay_journal(sub_counter, position, width, height)) {
+        ++sub_counter;
+        continue;
+      }
+
       // While tesseract version 3.05 (and older) handle inverted image (dark
       // background and light text) without problem for 4.x version use dark
       // text on light background.
       // https://tesseract-ocr.github.io/tessdoc/ImproveQuality#image-processing
 
-      ImageInverter inverter(image, image_size);
-      image = inverter.inverted_image;
-
-      if (dump_images) {
-        dump_pgm(subname, sub_counter, width, height, stride, image,
-                 image_size);
-      }
+      hot_path.begin();
+      size_t inverted_capacity;
+      unsigned char *const inverted =
+          prepared_images.acquire(image_size, &inverted_capacity);
+      invert_image(image, image_size, inverted);
+      image = inverted;
 
-      ocr_thread_t *ocr_thread = NULL;
-      if (threads.size() < static_cast<unsigned>(max_threads)) {
-        TessBaseAPI *tess_base_api = init_tesseract(
-            tesseract_data_path, tess_lang, blacklist, tesseract_oem, dpi);
-        if (tess_base_api == NULL) return -1;
-        ocr_thread = new ocr_thread_t(tess_base_api);
-        threads.push_back(ocr_thread);
-      } else if (max_threads == 1) {
-        ocr_thread = threads[0];
-      } else {
-        while (ocr_thread == NULL) {
-          for (unsigned i = 0; i < threads.size(); i++) {
-            if (threads[i]->done) {
-              threads[i]->t->join();
-              delete threads[i]->t;
-              ocr_thread = threads[i];
-              break;
-            }
-          }
-          if (ocr_thread == NULL) usleep(50);
-        }
-      }
-
-      unsigned char *image_cpy = (unsigned char *)malloc(image_size);
-      memcpy(image_cpy, image, image_size);
-
-      if (max_threads == 1)
-        do_ocr(ocr_thread->tess_base_api, &ocr_thread->done, &conv_subs, &mut,
-               sub_counter, width, height, stride, image_cpy, start_pts,
-               end_pts, verb);
-      else {
-        ocr_thread->done = false;
-        ocr_thread->t =
-            new thread(do_ocr, ocr_thread->tess_base_api, &ocr_thread->done,
-                       &conv_subs, &mut, sub_counter, width, height, stride,
-                       image_cpy, start_pts, end_pts, verb);
+      // Tesseract is fastest and most accurate within a certain glyph size.
+      // HD VobSubs have a lot larger text than DVDs, so resample per image.
+      line_stats_t const lines = analyze_lines(image, width, height, stride);
+      double const factor = text_scale_factor(lines, scale_height);
+      unsigned char *scaled = NULL;
+      size_t scaled_capacity = 0;
+      if (factor != 1.0) {
+        unsigned const scaled_width = max(1u, unsigned(width * factor + 0.5));
+        unsigned const scaled_height =
+            max(1u, unsigned(height * factor + 0.5));
+        size_t const scaled_size = size_t(scaled_width) * scaled_height;
+        scaled = prepared_images.acquire(scaled_size, &scaled_capacity);
+        scale_image(image, width, height, stride, scaled, scaled_width,
+                    scaled_height);
+        threshold_image(scaled, scaled_size);
+        image = scaled;
+        image_size = scaled_size;
+        width = stride = scaled_width;
+        height = scaled_height;
       }
 
+      prepare_span.end();
+      bool const queued =
+          queue_image(sub_counter, start_pts, end_pts, position, image,
+                      image_size, width, height, stride, lines.lines);
+      prepared_images.release(inverted, inverted_capacity);
+      prepared_images.release(scaled, scaled_capacity);
+      if (!queued) return -1;
       ++sub_counter;
     }
   }
 
+  poll_memory();
+  if (ocr_config.progress) ocr_config.progress->input_finished();
+  stats.enter(STAGE_WAIT);
+  while (!pending.empty()) {
+    if (!dispatch_largest()) return -1;
+  }
+  dumper.finish();
+  if (!corpus_out.close()) return 1;
+
+  chrono::steady_clock::duration busy{0}, fast_time{0}, accurate_time{0};
+  unsigned recognized = 0, fast_runs = 0, fast_accepted = 0, accurate_runs = 0;
   for (unsigned i = 0; i < threads.size(); ++i) {
-    if (threads[i]->t != NULL) {
-      threads[i]->t->join();
-      delete threads[i]->t;
-    }
-    threads[i]->tess_base_api->End();
-    delete threads[i]->tess_base_api;
+    stop_ocr_thread(threads[i]);
+    busy += threads[i]->busy;
+    recognized += threads[i]->images;
+    stats.add_worker(threads[i]->images, threads[i]->busy,
+                     chrono::steady_clock::now() - threads[i]->created,
+                     threads[i]->latencies);
+    fast_runs += threads[i]->fast_runs;
+    fast_accepted += threads[i]->fast_accepted;
+    accurate_runs += threads[i]->accurate_runs;
+    fast_time += threads[i]->fast_time;
+    accurate_time += threads[i]->accurate_time;
     delete threads[i];
   }
+  if (!threads.empty()) {
+    double const wall =
+        chrono::duration<double>(chrono::steady_clock::now() - ocr_start)
+            .count();
+    double const utilization =
+        wall > 0 ? chrono::duration<double>(busy).count() /
+                       (wall * threads.size())
+                 : 0.0;
+    // cache hits and journal replays are in conv_subs but took no OCR time
+    cout << "OCR: " << recognized << " images on " << threads.size()
+         << " threads, " << fixed << setprecision(1) << utilization * 100
+         << "% utilization\n";
+  }
+  if (fast_runs > 0) {
+    cout << "Cascade: fast engine kept " << fast_accepted << " of "
+         << fast_runs << " images ("
+         << chrono::duration<double>(fast_time).count() << " s), accurate "
+         << "engine recognized " << accurate_runs << " ("
+         << chrono::duration<double>(accurate_time).count() << " s)\n";
+  }
+
+  if (!telemetry.close()) return 1;
+
+  if (cache.is_open()) {
+    cout << "OCR cache: " << cache.hits << " of " << cache.hits + cache.misses
+         << " images found\n";
+    cache.close();
+  }
 
+  stats.enter(STAGE_WRITE);
+  trace_span write_span("write");
   struct {
     bool operator()(sub_text_t a, sub_text_t b) const {
       return a.counter < b.counter;
@@ -446,21 +1365,56 @@ int main(int argc, char **argv) {
   } sort_fct;
   sort(conv_subs.begin(), conv_subs.end(), sort_fct);
 
-  // write the file, fixing end_pts when needed
+  unsigned timeouts = 0;
   for (unsigned i = 0; i < conv_subs.size(); ++i) {
-    if (conv_subs[i].end_pts == UINT_MAX || (dumb && i + 1 < conv_subs.size()))
+    if (!conv_subs[i].timed_out) continue;
+    if (timeouts++ == 0)
+      cerr << "OCR time limit of " << ocr_timeout << " ms hit for:";
+    cerr << ' ' << conv_subs[i].counter;
+  }
+  if (timeouts > 0) cerr << " (" << timeouts << " images)\n";
+
+  stats.memory[MEMORY_TEXT].allocate(conv_subs.capacity() *
+                                     sizeof(sub_text_t));
+  for (unsigned i = 0; i < conv_subs.size(); ++i) {
+    if (conv_subs[i].text)
+      stats.memory[MEMORY_TEXT].allocate(strlen(conv_subs[i].text) + 1);
+  }
+
+  // write the file, fixing end_pts when needed. A subtitle without an end is
+  // shown until the next one, the last one for open_end_duration (90 kHz).
+  enum { open_end_duration = 5 * 90000 };
+  writer->begin(frame_width, frame_height);
+  for (unsigned i = 0; i < conv_subs.size(); ++i) {
+    if ((conv_subs[i].end_pts == UINT_MAX || dumb) &&
+        i + 1 < conv_subs.size())
       conv_subs[i].end_pts = conv_subs[i + 1].start_pts;
+    else if (conv_subs[i].end_pts == UINT_MAX)
+      conv_subs[i].end_pts = conv_subs[i].start_pts + open_end_duration;
 
-    fprintf(srtout, "%u\n%s --> %s\n%s\n\n", conv_subs[i].counter,
-            pts2srt(conv_subs[i].start_pts).c_str(),
-            pts2srt(conv_subs[i].end_pts).c_str(), conv_subs[i].text);
+    sub_text_t const &sub = conv_subs[i];
+    subtitle_cue_t const cue = {sub.counter,         sub.start_pts,
+                                sub.end_pts,         sub.text,
+                                sub.position,        sub.confidence.words,
+                                sub.confidence.mean, sub.confidence.min};
+    writer->write(cue);
 
     delete[] conv_subs[i].text;
     conv_subs[i].text = 0x0;
   }
 
-  fclose(srtout);
-  cout << "Wrote Subtitles to '" << srt_filename << "'\n";
-  vobsub_close(vob);
+  if (!writer->close()) return 1;
+  write_span.end();
+  journal.finish();
+  cout << "Wrote Subtitles to '" << output_file << "'\n";
+  progress.finish();
+
+  stats.finish();
+  stats.subtitles = conv_subs.size();
+  stats.peak_dump = dumper.peak_queue;
+  if (show_stats) cout << stats.report();
+  if (!stats_json.empty() and !stats.write_json(stats_json)) return 1;
+  if (!trace_file.empty() and !trace_finish(trace_file)) return 1;
+  if (vob) vobsub_close(vob);
   spudec_free(spu);
 }
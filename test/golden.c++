@@ -0,0 +1,358 @@
+/*
+ *  VobSub2SRT is a simple command line program to convert .idx/.sub subtitles
+ *  into .srt text subtitles by using OCR (tesseract). See README.md.
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Golden output and throughput tests, registered with ctest. The synthetic
+// subtitles are converted with the fake OCR engine, so the output only
+// depends on the demuxing, decoding, image preparation, scheduling and
+// writing.
+//
+// Without --throughput every case is converted with 1, 2 and --threads OCR
+// threads. The output must be the same each time and match the golden file
+// byte for byte. With --throughput a single threaded conversion is timed
+// against the baseline. --save writes the goldens (or the baseline) instead.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "process.h++"
+#include "synth.h++"
+
+// VobSub2SRT
+#include "cmd_options.h++"
+
+using namespace std;
+
+namespace {
+/// A synthetic subtitle and how to convert it
+struct case_t {
+  string name;
+  corpus_options_t corpus;
+  vector<string> args;  ///< for vobsub2srt
+  char const *extension;
+};
+
+vector<case_t> make_cases() {
+  vector<case_t> cases;
+  case_t text = {"text", corpus_options_t(), vector<string>(), "srt"};
+  text.corpus.cues = 200;
+  cases.push_back(text);
+
+  case_t dumb = text;
+  dumb.name = "dumb";
+  dumb.args.push_back("--dumb");
+  cases.push_back(dumb);
+
+  // no stop display command, every cue ends with the next one (end_pts is
+  // UINT_MAX) and the last one after the default duration
+  case_t open_end = text;
+  open_end.name = "open-end";
+  open_end.corpus.duration = 0;
+  cases.push_back(open_end);
+
+  // packets split across many packs and repeated images
+  case_t split = text;
+  split.name = "split";
+  split.corpus.text = false;
+  split.corpus.max_chunk = 300;
+  split.corpus.duplicates = 0.25;
+  split.corpus.seed = 7;
+  cases.push_back(split);
+
+  // SPU packets of 2008 to 2047 bytes, which fill the first pack up to a few
+  // bytes or leave a few for the next one
+  case_t boundary = text;
+  boundary.name = "pack-boundary";
+  boundary.corpus.cues = 40;
+  boundary.corpus.width = 160;
+  boundary.corpus.height = 32;
+  boundary.corpus.packet_size = 2008;
+  cases.push_back(boundary);
+
+  case_t streams = text;
+  streams.name = "second-stream";
+  streams.corpus.cues = 100;
+  streams.corpus.streams = 2;
+  streams.args.push_back("--index");
+  streams.args.push_back("1");
+  cases.push_back(streams);
+
+  case_t vtt = text;
+  vtt.name = "vtt";
+  vtt.args.push_back("--format");
+  vtt.args.push_back("vtt");
+  vtt.extension = "vtt";
+  cases.push_back(vtt);
+  return cases;
+}
+
+bool read_file(string const &filename, string &data) {
+  ifstream in(filename.c_str(), ios::binary);
+  if (!in) return false;
+  ostringstream out;
+  out << in.rdbuf();
+  data = out.str();
+  return true;
+}
+
+bool write_file(string const &filename, string const &data) {
+  ofstream out(filename.c_str(), ios::binary);
+  out << data;
+  if (!out) cerr << "Can't write " << filename << '\n';
+  return bool(out);
+}
+
+// Where the output first differs, as line number (from 1)
+size_t first_difference(string const &a, string const &b) {
+  size_t const end = min(a.size(), b.size());
+  size_t i = 0;
+  while (i < end and a[i] == b[i]) ++i;
+  return count(a.begin(), a.begin() + i, '\n') + 1;
+}
+
+vector<string> convert_args(string const &vobsub2srt, unsigned threads,
+                            string const &output, case_t const &test,
+                            string const &subname) {
+  ostringstream max_threads;
+  max_threads << threads;
+  vector<string> args;
+  args.push_back(vobsub2srt);
+  args.push_back("--ocr-engine");
+  args.push_back("fake");
+  args.push_back("--max-threads");
+  args.push_back(max_threads.str());
+  args.push_back("--output");
+  args.push_back(output);
+  args.insert(args.end(), test.args.begin(), test.args.end());
+  args.push_back(subname);
+  return args;
+}
+
+double median(vector<double> values) {
+  sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+/// Settings of a run
+struct check_t {
+  string vobsub2srt, work_dir, goldens;
+  vector<unsigned> thread_counts;
+  int repeat;
+  bool save;
+  vector<string> created;  ///< files to remove from a temporary work_dir
+};
+
+// Converts the case with every thread count and compares the output
+bool check_output(check_t &check, case_t const &test) {
+  string const subname = check.work_dir + "/" + test.name;
+  string const output = subname + "." + test.extension;
+  string const golden_name =
+      check.goldens + "/" + test.name + "." + test.extension;
+  check.created.push_back(subname + ".idx");
+  check.created.push_back(subname + ".sub");
+  check.created.push_back(output);
+  if (!write_corpus(subname, test.corpus)) return false;
+  string first;
+  bool ok = true;
+  for (size_t t = 0; t < check.thread_counts.size(); ++t) {
+    run_usage_t usage;
+    string data;
+    if (!run_program(convert_args(check.vobsub2srt, check.thread_counts[t],
+                                  output, test, subname),
+                     usage))
+      return false;
+    if (!read_file(output, data)) {
+      cerr << "vobsub2srt did not write " << output << '\n';
+      return false;
+    }
+    if (t == 0) {
+      first = data;
+    } else if (data != first) {
+      cout << test.name << ": MISMATCH with " << check.thread_counts[t]
+           << " threads at line " << first_difference(first, data) << '\n';
+      ok = false;
+    }
+  }
+  if (check.save) return ok and write_file(golden_name, first);
+  string golden;
+  if (!read_file(golden_name, golden)) {
+    cout << test.name << ": NO GOLDEN " << golden_name << '\n';
+    return false;
+  }
+  if (golden != first) {
+    cout << test.name << ": MISMATCH with " << golden_name << " at line "
+         << first_difference(golden, first) << '\n';
+    return false;
+  }
+  if (ok) cout << test.name << ": ok\n";
+  return ok;
+}
+
+// The time of a single threaded conversion relative to the time it takes to
+// write the synthetic subtitles. This evens out the load of the machine a bit,
+// but not its kind: the two differ in how they use the caches and memory. So
+// the baseline only holds on the machine it was saved on.
+bool measure_throughput(check_t &check, double *relative) {
+  case_t test = make_cases()[0];
+  test.name = "throughput";
+  test.corpus.cues = 2000;
+  string const subname = check.work_dir + "/" + test.name;
+  string const output = subname + ".srt";
+  check.created.push_back(subname + ".idx");
+  check.created.push_back(subname + ".sub");
+  check.created.push_back(output);
+  vector<double> write_times, convert_times;
+  for (int r = 0; r < check.repeat; ++r) {
+    auto const start = chrono::steady_clock::now();
+    if (!write_corpus(subname, test.corpus)) return false;
+    write_times.push_back(
+        chrono::duration<double>(chrono::steady_clock::now() - start)
+            .count());
+    run_usage_t usage;
+    if (!run_program(
+            convert_args(check.vobsub2srt, 1, output, test, subname), usage))
+      return false;
+    convert_times.push_back(usage.wall);
+  }
+  *relative = median(convert_times) / median(write_times);
+  cout << fixed << setprecision(3) << "throughput: "
+       << test.corpus.cues / median(convert_times) << " cues/s, "
+       << *relative << " times the time to write them";
+  return true;
+}
+
+// Baselines are "name value" lines
+bool load_baseline(string const &filename, map<string, double> &baseline) {
+  ifstream in(filename.c_str());
+  if (!in) {
+    cerr << "Can't read baseline " << filename << '\n';
+    return false;
+  }
+  string name;
+  double value;
+  while (in >> name >> value) baseline[name] = value;
+  return true;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  check_t check;
+  string only;
+  int threads = max(4u, thread::hardware_concurrency()), tolerance = 50;
+  bool throughput = false;
+  check.repeat = 5;
+  check.save = false;
+  {
+    cmd_options opts;
+    opts.add_option("vobsub2srt", check.vobsub2srt,
+                    "the program to check (default: vobsub2srt next to "
+                    "this program)")
+        .add_option("goldens", check.goldens,
+                    "directory of the golden files and the throughput "
+                    "baseline (REQUIRED)")
+        .add_option("case", only, "only check this case")
+        .add_option("threads", threads,
+                    "the most --max-threads to convert every case with, "
+                    "besides 1 and 2 (default: the number of cores, at "
+                    "least 4)")
+        .add_option("throughput", throughput,
+                    "time a conversion against the baseline instead")
+        .add_option("tolerance", tolerance,
+                    "percent the conversion may be slower than the baseline "
+                    "(default: 50, runs vary by about 30%)")
+        .add_option("repeat", check.repeat,
+                    "timed runs, the median is compared (default: 5)")
+        .add_option("save", check.save,
+                    "write the goldens or the baseline instead of comparing")
+        .add_option("work-dir", check.work_dir,
+                    "keep the synthetic subtitles and the output in this "
+                    "directory (default: a temporary directory)");
+    if (!opts.parse_cmd(argc, argv)) return 1;
+  }
+  if (check.goldens.empty() or threads < 1 or check.repeat < 1) {
+    cerr << "Invalid --goldens, --threads or --repeat\n";
+    return 1;
+  }
+  if (check.vobsub2srt.empty())
+    check.vobsub2srt = program_next_to(argv[0], "vobsub2srt");
+  check.thread_counts.push_back(1);
+  check.thread_counts.push_back(2);
+  check.thread_counts.push_back(threads);
+  sort(check.thread_counts.begin(), check.thread_counts.end());
+  check.thread_counts.erase(
+      unique(check.thread_counts.begin(), check.thread_counts.end()),
+      check.thread_counts.end());
+  string const baseline_name = check.goldens + "/throughput";
+  map<string, double> baseline;
+  if (throughput and !check.save and !load_baseline(baseline_name, baseline))
+    return 1;
+  bool const temporary = check.work_dir.empty();
+  if (!make_work_dir(check.work_dir)) return 1;
+
+  bool ok = true;
+  if (throughput) {
+    double relative;
+    ok = measure_throughput(check, &relative);
+    if (ok and check.save) {
+      ostringstream line;
+      line << "relative_time " << relative << '\n';
+      ok = write_file(baseline_name, line.str());
+    } else if (ok) {
+      double const base = baseline["relative_time"];
+      double const change = base > 0 ? (relative / base - 1.0) * 100.0 : 0;
+      cout << ", baseline " << base << setprecision(1) << showpos << " ("
+           << change << "%)" << noshowpos;
+      if (change > tolerance) {
+        cout << "  REGRESSION";
+        ok = false;
+      }
+    }
+    cout << '\n';
+  } else {
+    vector<case_t> const cases = make_cases();
+    bool found = false;
+    for (size_t c = 0; c < cases.size(); ++c) {
+      if (!only.empty() and cases[c].name != only) continue;
+      found = true;
+      if (!check_output(check, cases[c])) ok = false;
+    }
+    if (!found) {
+      cerr << "Unknown case '" << only << "'\n";
+      ok = false;
+    }
+  }
+
+  if (temporary) {
+    for (size_t i = 0; i < check.created.size(); ++i)
+      unlink(check.created[i].c_str());
+    rmdir(check.work_dir.c_str());
+  }
+  return ok ? 0 : 1;
+}